@@ -39,9 +39,20 @@
 /// file: acme_aabbTree.hh
 ///
 
+#ifndef INCLUDE_ACME_AABBTREE
+#define INCLUDE_ACME_AABBTREE
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+
 #include "acme.hh"
 #include "acme_aabb.hh"
+#include "acme_ball.hh"
 #include "acme_math.hh"
+#include "acme_plane.hh"
+#include "acme_ray.hh"
 
 namespace acme
 {
@@ -58,6 +69,10 @@ namespace acme
   //! Axis-aligned bouding box tree class container
   /**
    * Axis-aligned bouding box AABB tree.
+   * The tree is stored as a flat array of nodes in depth-first order: the box
+   * of each node is stored inline, the left child of an inner node is the next
+   * node in the array and the right child is referenced by a 32-bit index.
+   * Leaves reference a range of the (reordered) vector of input boxes.
   */
   class AABBtree
   {
@@ -65,9 +80,74 @@ namespace acme
     typedef std::shared_ptr<AABBtree> ptr; //!< Shared ointer to AABB tree object
     typedef std::vector<ptr> vecptr;       //!< Vector of pointers to AABB tree objects
 
+    //! AABB tree building methods
+    enum method
+    {
+      MIDPOINT = 0, //!< Split at the midpoint of the longest axis of the box
+      SAH = 1,      //!< Split with the binned surface area heuristic
+      LBVH = 2      //!< Linear build on the Morton codes of the box centroids
+    };
+
+    //! AABB tree node
+    struct node
+    {
+      real min[3];   //!< Node box minimum point
+      real max[3];   //!< Node box maximum point
+      integer index; //!< Right child index (inner node) or first box index (leaf)
+      integer count; //!< Number of boxes in the leaf (zero for inner nodes)
+    };
+
+    typedef std::vector<node> vecnode; //!< Vector of AABB tree nodes
+
+    //! AABB tree quality statistics
+    struct statistics
+    {
+      integer nodes;                        //!< Number of nodes
+      integer leaves;                       //!< Number of leaves
+      integer depth;                        //!< Maximum leaf depth (zero for the root)
+      real mean_depth;                      //!< Mean leaf depth
+      real occupancy;                       //!< Mean number of boxes per leaf
+      real cost;                            //!< Surface area heuristic cost
+      real overlap;                         //!< Total overlap volume of the sibling nodes
+      std::vector<integer> depth_histogram; //!< Number of leaves at each depth
+      std::vector<integer> leaf_histogram;  //!< Number of leaves with each number of boxes
+    };
+
+    //! AABB tree query counters
+    struct counters
+    {
+      size_t nodes; //!< Number of nodes (or pairs of nodes) visited
+      size_t boxes; //!< Number of leaf box tests
+      size_t items; //!< Number of boxes (or pairs of boxes) reported
+    };
+
+    //! Affine transformation between the frames of two AABB trees
+    struct relative
+    {
+      real linear[3][3];           //!< Linear part from the input tree frame to this tree frame
+      real linear_abs[3][3];       //!< Absolute values of the linear part
+      real translation[3];         //!< Translation from the input tree frame to this tree frame
+      real inverse[3][3];          //!< Linear part from this tree frame to the input tree frame
+      real inverse_abs[3][3];      //!< Absolute values of the inverse linear part
+      real inverse_translation[3]; //!< Translation from this tree frame to the input tree frame
+    };
+
   private:
-    aabb::ptr m_ptrbox; //!< Pointer to AABB tree
-    AABBtree::vecptr m_children;
+    vecnode m_nodes;      //!< Tree nodes in depth-first order (root first)
+    aabb::vecptr m_boxes;           //!< Tree boxes sorted by leaf
+    std::vector<integer> m_indices; //!< Input position of the tree boxes sorted by leaf
+
+    static integer const STACK_SIZE = 64;   //!< Size of the local stack of the traversal kernels
+    static uint32_t const FILE_VERSION = 1; //!< Version of the binary file format
+
+    AABBtree::method m_method;   //!< Building method
+    integer m_bins;              //!< Number of bins for the surface area heuristic
+    real m_cost_traversal;       //!< Surface area heuristic cost of a node traversal
+    real m_cost_intersection;    //!< Surface area heuristic cost of a box intersection
+    real m_cost_build;           //!< Surface area heuristic cost of the tree after the last build
+    integer m_leaf_size;         //!< Maximum number of boxes in a leaf
+    bool m_counting;             //!< Query counters flag
+    mutable counters m_counters; //!< Query counters
 
     AABBtree(AABBtree const &tree);
 
@@ -86,12 +166,124 @@ namespace acme
     bool
     isEmpty(void) const;
 
+    //! Set AABB tree building method and surface area heuristic cost model
+    /**
+     * The surface area heuristic splits a node at the cut of least cost, that
+     * is the traversal cost plus the intersection cost of the boxes of each
+     * child weighted by the child to parent area ratio. A node with at most
+     * the leaf size boxes is kept as a leaf if intersecting all of its boxes
+     * costs no more than the best split.
+     */
+    void
+    setMethod(
+        AABBtree::method type,       //!< Building method
+        integer bins = 16,           //!< Number of bins for the surface area heuristic
+        real cost_traversal = 1.0,   //!< Cost of a node traversal
+        real cost_intersection = 1.0 //!< Cost of a box intersection
+    );
+
+    //! Get AABB tree building method
+    AABBtree::method
+    getMethod(void) const;
+
+    //! Set maximum number of boxes in a leaf (used by the next build)
+    void
+    setLeafSize(
+        integer leaf_size //!< Maximum number of boxes in a leaf
+    );
+
+    //! Get maximum number of boxes in a leaf
+    integer
+    getLeafSize(void) const;
+
     //! Build AABB tree given a list of boxes
     void
     build(
         aabb::vecptr const &boxes //!< List of boxes
     );
 
+    //! Refit the AABB tree node boxes to the updated tree boxes keeping the topology
+    void
+    refit(void);
+
+    //! Replace the tree boxes and refit the AABB tree keeping the topology
+    void
+    refit(
+        aabb::vecptr const &boxes //!< List of boxes in the same order used to build the tree
+    );
+
+    //! Ratio between the current and the after-build surface area heuristic cost
+    real
+    degradation(void) const;
+
+    //! Get AABB tree nodes const reference
+    vecnode const &
+    nodes(void) const;
+
+    //! Get AABB tree boxes (sorted by leaf) const reference
+    aabb::vecptr const &
+    boxes(void) const;
+
+    //! Compute the surface area heuristic cost of the AABB tree
+    real
+    costSAH(void) const;
+
+    //! Checksum of the geometry of a list of boxes (tied to the saved AABB trees)
+    static uint64_t
+    checksum(
+        aabb::vecptr const &boxes //!< List of boxes
+    );
+
+    //! Save the AABB tree to a binary file, return false if the file cannot be written
+    /**
+     * The file stores the nodes, the input position of the leaf boxes and the
+     * checksum of the boxes used to build the tree, in the native byte order.
+     */
+    bool
+    save(
+        std::string const &filename //!< Output file name
+    ) const;
+
+    //! Load the AABB tree from a binary file saved on the same list of boxes
+    /**
+     * The file is memory-mapped where available, but the nodes and the box
+     * positions are copied into the tree and the input boxes are checksummed,
+     * so the load is still linear in the number of boxes: only the build is
+     * saved. Return false and leave the tree empty if the file cannot be read,
+     * if its version is not supported, if the checksum does not match the input
+     * boxes or if the nodes do not form a valid tree on them, so that the tree
+     * can be built instead.
+     */
+    bool
+    load(
+        std::string const &filename, //!< Input file name
+        aabb::vecptr const &boxes    //!< List of boxes used to build the saved tree
+    );
+
+    //! Compute the AABB tree quality statistics
+    statistics
+    getStatistics(void) const;
+
+    //! Enable or disable the query counters
+    /**
+     * When enabled, the intersection and collision queries add up the visited
+     * nodes, the leaf box tests and the reported items in the counters. The
+     * counters are shared, so concurrent queries on the same tree are not
+     * counted reliably.
+     */
+    void
+    setCounting(
+        bool counting //!< Query counters flag
+    );
+
+    //! Reset the query counters
+    void
+    resetCounters(void);
+
+    //! Get the query counters const reference
+    counters const &
+    getCounters(void) const;
+
     //! Print AABB tree data
     void
     print(
@@ -100,97 +292,777 @@ namespace acme
     ) const;
 
     //! Check if two AABB tree collide
-    template <typename collision>
+    template <typename collision_function>
     bool
     collision(
-        AABBtree const &tree,  //!< AABB tree used to check collision
-        collision function,    //!< Function to check if the contents of two aabb collide
-        bool swap_tree = false //!< If true exchange the tree in computation
+        AABBtree const &tree,        //!< AABB tree used to check collision
+        collision_function function, //!< Function to check if the contents of two aabb collide
+        bool swap_tree = false       //!< If true exchange the tree in computation
     ) const
     {
+      if (this->isEmpty() || tree.isEmpty())
+        return false;
+      auto collide = [&](integer a, integer b) {
+        return swap_tree ? function(tree.m_boxes[b], this->m_boxes[a])
+                         : function(this->m_boxes[a], tree.m_boxes[b]);
+      };
+      return this->traverse(tree, nullptr, 0, 0, collide);
+    }
 
-      // check aabb with
-      if (!tree.m_ptrbox->intersects(*this->m_ptrbox))
+    //! Check if two AABB trees collide, the input tree being placed by an affine transformation
+    /**
+     * The transformation maps the input tree frame into this tree frame, so a
+     * rigid body keeps a tree built once in its own coordinates. The boxes of
+     * the input tree are tested as oriented boxes against the boxes of this
+     * tree on the face axes of both frames: the test is conservative, since
+     * the edge cross product axes are skipped. The function receives the boxes
+     * in their own frames.
+     */
+    template <typename collision_function>
+    bool
+    collision(
+        AABBtree const &tree,        //!< AABB tree used to check collision
+        affine const &transform,     //!< Transformation from the input tree frame to this tree frame
+        collision_function function, //!< Function to check if the contents of two aabb collide
+        bool swap_tree = false       //!< If true exchange the tree in computation
+    ) const
+    {
+      if (this->isEmpty() || tree.isEmpty())
         return false;
+      relative transform_in;
+      relativeTransform(transform, transform_in);
+      auto collide = [&](integer a, integer b) {
+        return swap_tree ? function(tree.m_boxes[b], this->m_boxes[a])
+                         : function(this->m_boxes[a], tree.m_boxes[b]);
+      };
+      return this->traverse(tree, &transform_in, 0, 0, collide);
+    }
+
+    //! Compute all the intersection candidates of AABB trees
+    void
+    intersection(
+        AABBtree const &tree,               //!< AABB tree used to check collision
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool swap_tree = false              //!< If true exchange the tree in computation
+    ) const;
+
+    //! Compute all the intersection candidates of AABB trees, the input tree being placed by an affine transformation
+    /**
+     * The node boxes are tested as in the transformed collision, and the boxes
+     * of each pair are in their own frames.
+     */
+    void
+    intersection(
+        AABBtree const &tree,               //!< AABB tree used to check collision
+        affine const &transform,            //!< Transformation from the input tree frame to this tree frame
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool swap_tree = false              //!< If true exchange the tree in computation
+    ) const;
+
+    //! Compute all the tree boxes that overlap an external box
+    void
+    intersection(
+        aabb const &box,            //!< Input box
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
 
-      int icase = (this->m_children.empty() ? 0 : 1) +
-                  (tree.m_children.empty() ? 0 : 2);
+    //! Compute all the tree boxes hit by a ray
+    void
+    intersection(
+        ray const &ray_in,          //!< Input ray
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
 
-      switch (icase)
+    //! Compute all the tree boxes that straddle a plane
+    void
+    intersection(
+        plane const &plane_in,      //!< Input plane
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Compute all the tree boxes in the half-space on the plane normal side
+    /**
+     * Subtrees entirely on the normal side are accepted at once, subtrees
+     * entirely on the other side are skipped. The boxes straddling the plane
+     * are returned as candidates, since their contents may lie in either
+     * half-space.
+     */
+    void
+    halfSpace(
+        plane const &plane_in,      //!< Input plane
+        aabb::vecptr &insideList,   //!< Output list of boxes in the half-space
+        aabb::vecptr &candidateList //!< Output list of boxes straddling the plane
+    ) const;
+
+    //! Compute all the tree boxes that overlap a ball
+    void
+    intersection(
+        ball const &ball_in,        //!< Input ball
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Find the k tree boxes nearest to a point
+    /**
+     * Best-first traversal on a priority queue ordered by the distance of the
+     * point to the node boxes. When a leaf is reached the distance of the point
+     * to the content of its boxes is computed by the input function, which must
+     * not be less than the distance to the box itself. The candidates are
+     * appended in order of increasing distance.
+     */
+    template <typename distance_function>
+    void
+    nearest(
+        point const &query,             //!< Query point
+        integer k,                      //!< Number of candidates
+        distance_function function,     //!< Function returning the distance of the point to the content of an aabb
+        aabb::vecptr &candidateList,    //!< Output candidate list
+        std::vector<real> &distanceList //!< Output candidate distance list
+    ) const
+    {
+      if (this->isEmpty() || k <= 0)
+        return;
+
+      // The boxes of visited leaves are stored with negative index -(b + 1)
+      typedef std::pair<real, integer> item;
+      std::priority_queue<item, std::vector<item>, std::greater<item>> queue;
+      queue.push(item(boxDistance(this->m_nodes[0], query), 0));
+      integer found = 0;
+      while (!queue.empty() && found < k)
       {
-      case 0: // both leaf, use aabb intersection algorithm
-        if (swap_tree)
-          return function(tree.m_ptrbox, this->m_ptrbox);
+        item top = queue.top();
+        queue.pop();
+        integer i = top.second;
+        if (i < 0)
+        {
+          candidateList.push_back(this->m_boxes[-i - 1]);
+          distanceList.push_back(top.first);
+          ++found;
+          continue;
+        }
+        node const &node_i = this->m_nodes[i];
+        if (node_i.count > 0)
+        {
+          for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+            queue.push(item(function(this->m_boxes[b]), -b - 1));
+        }
         else
-          return function(this->m_ptrbox, tree.m_ptrbox);
-      case 1: // first is a tree, second is a leaf
+        {
+          queue.push(item(boxDistance(this->m_nodes[i + 1], query), i + 1));
+          queue.push(item(boxDistance(this->m_nodes[node_i.index], query), node_i.index));
+        }
+      }
+    }
+
+    //! Find the k tree boxes nearest to a point
+    void
+    nearest(
+        point const &query,             //!< Query point
+        integer k,                      //!< Number of candidates
+        aabb::vecptr &candidateList,    //!< Output candidate list
+        std::vector<real> &distanceList //!< Output candidate distance list
+    ) const;
+
+    //! Cast a ray into the AABB tree
+    /**
+     * Front-to-back traversal: the children of a node are visited in order of
+     * ray parameter at the box entry, and the subtrees entered beyond the
+     * current hit are skipped. The input function gets a box and the current
+     * ray parameter t (origin + t * direction), and returns true if the box
+     * content is hit at a lower t, which it writes back. If any_hit the
+     * traversal stops at the first hit.
+     */
+    template <typename raycast_function>
+    bool
+    raycast(
+        ray const &ray_in,         //!< Input ray
+        real t_max,                //!< Maximum ray parameter
+        raycast_function function, //!< Function to compute the ray parameter of the hit with the contents of an aabb
+        bool any_hit,              //!< If true stop at the first hit
+        aabb::ptr &boxOut,         //!< Hit box
+        real &tOut                 //!< Ray parameter of the hit
+    ) const
+    {
+      if (this->isEmpty())
+        return false;
+      real origin[3];
+      real inv_direction[3];
+      for (size_t k = 0; k < 3; ++k)
       {
-        typename AABBtree::vecptr::const_iterator it;
-        for (it = this->m_children.begin(); it != this->m_children.end(); ++it)
-          if (tree.collision(**it, function, !swap_tree))
-            return true;
+        origin[k] = ray_in.origin()[k];
+        inv_direction[k] = 1.0 / ray_in.direction()[k];
       }
-      break;
-      case 2: // first leaf, second is a tree
+      tOut = t_max;
+      return this->raycast(origin, inv_direction, 0, function, any_hit, boxOut, tOut);
+    }
+
+    //! Compute all the pairs of overlapping boxes of the AABB tree
+    /**
+     * Every unordered pair of distinct boxes is reported once, with the first
+     * box preceding the second one in leaf order.
+     */
+    void
+    selfIntersection(
+        aabb::vecpairptr &intersectionList //!< List of pair aabb that overlaps
+    ) const;
+
+    //! Compute all the intersection candidates of AABB trees in parallel
+    /**
+     * The top levels of the traversal are expanded into a list of node pairs
+     * that are processed by the OpenMP threads. If deterministic, every node
+     * pair has its own output buffer and the buffers are merged in order, so
+     * that the list is the same as the serial one for any number of threads;
+     * otherwise every thread has its own output buffer.
+     */
+    void
+    parallelIntersection(
+        AABBtree const &tree,               //!< AABB tree used to check collision
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool deterministic = true,          //!< If true keep the serial ordering
+        bool swap_tree = false              //!< If true exchange the tree in computation
+    ) const;
+
+    //! Visit all the pairs of overlapping boxes of two AABB trees
+    /**
+     * The function receives the input positions of the two boxes, as given
+     * to the build of each tree, and returns true to stop the traversal. No
+     * pair list is stored, so the narrow phase can run inside the function.
+     * Return true if the traversal has been stopped.
+     */
+    template <typename visit_function>
+    bool
+    visitIntersection(
+        AABBtree const &tree,    //!< AABB tree used to check intersection
+        visit_function function, //!< Function called on each pair of input positions (true to stop)
+        bool swap_tree = false   //!< If true exchange the tree in computation
+    ) const
+    {
+      if (this->isEmpty() || tree.isEmpty())
+        return false;
+      auto visit = [&](integer a, integer b) {
+        return swap_tree ? function(tree.m_indices[b], this->m_indices[a])
+                         : function(this->m_indices[a], tree.m_indices[b]);
+      };
+      return this->traverse(tree, nullptr, 0, 0, visit);
+    }
+
+    //! Check if two AABB tree nodes overlap
+    static bool
+    intersects(
+        node const &node0, //!< Input node 0
+        node const &node1  //!< Input node 1
+    )
+    {
+      return node0.min[0] <= node1.max[0] && node0.max[0] >= node1.min[0] &&
+             node0.min[1] <= node1.max[1] && node0.max[1] >= node1.min[1] &&
+             node0.min[2] <= node1.max[2] && node0.max[2] >= node1.min[2];
+    }
+
+    //! Check if two boxes in different frames overlap on the face axes of both frames
+    static bool
+    intersects(
+        real const min0[3],          //!< Minimum point of box 0 (this tree frame)
+        real const max0[3],          //!< Maximum point of box 0 (this tree frame)
+        real const min1[3],          //!< Minimum point of box 1 (input tree frame)
+        real const max1[3],          //!< Maximum point of box 1 (input tree frame)
+        relative const &transform_in //!< Transformation between the tree frames
+    )
+    {
+      return overlaps(min0, max0, min1, max1, transform_in.linear,
+                      transform_in.linear_abs, transform_in.translation) &&
+             overlaps(min1, max1, min0, max0, transform_in.inverse,
+                      transform_in.inverse_abs, transform_in.inverse_translation);
+    }
+
+    //! Check if two AABB tree nodes in different frames overlap
+    static bool
+    intersects(
+        node const &node0,           //!< Input node 0 (this tree frame)
+        node const &node1,           //!< Input node 1 (input tree frame)
+        relative const &transform_in //!< Transformation between the tree frames
+    )
+    {
+      return intersects(node0.min, node0.max, node1.min, node1.max, transform_in);
+    }
+
+    //! Compute the transformation between the frames of two AABB trees
+    static void
+    relativeTransform(
+        affine const &transform, //!< Transformation from the input tree frame to this tree frame
+        relative &transform_out  //!< Output transformation between the tree frames
+    );
+
+    //! Surface area of a node box
+    static real
+    area(
+        node const &node_in //!< Input node
+    )
+    {
+      real dx = node_in.max[0] - node_in.min[0];
+      real dy = node_in.max[1] - node_in.min[1];
+      real dz = node_in.max[2] - node_in.min[2];
+      return 2.0 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    //! Minimum distance of a point to a node box
+    static real
+    boxDistance(
+        node const &node_in,  //!< Input node
+        point const &point_in //!< Query point
+    )
+    {
+      real dx = std::max(0.0, std::max(node_in.min[0] - point_in.x(), point_in.x() - node_in.max[0]));
+      real dy = std::max(0.0, std::max(node_in.min[1] - point_in.y(), point_in.y() - node_in.max[1]));
+      real dz = std::max(0.0, std::max(node_in.min[2] - point_in.z(), point_in.z() - node_in.max[2]));
+      return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    //! Side of a node box with respect to a plane (1 normal side, -1 other side, 0 straddling)
+    static integer
+    side(
+        node const &node_in,  //!< Input node
+        real const normal[3], //!< Plane normal
+        real offset           //!< Plane normal times plane origin
+    )
+    {
+      real center = -offset;
+      real radius = 0.0;
+      for (size_t k = 0; k < 3; ++k)
       {
-        typename AABBtree::vecptr::const_iterator it;
-        for (it = tree.m_children.begin();
-             it != tree.m_children.end(); ++it)
-          if (this->collision(**it, function, swap_tree))
-            return true;
+        center += 0.5 * (node_in.max[k] + node_in.min[k]) * normal[k];
+        radius += 0.5 * (node_in.max[k] - node_in.min[k]) * std::abs(normal[k]);
       }
-      break;
-      case 3: // first is a tree, second is a tree
+      if (center > radius)
+        return 1;
+      else if (center < -radius)
+        return -1;
+      else
+        return 0;
+    }
+
+    //! Check if a ray hits a node box with the slab test
+    /**
+     * A zero direction component gives an infinite inverse, the axis is then
+     * tested on the origin to avoid the 0 * inf products.
+     */
+    static bool
+    intersects(
+        node const &node_in,         //!< Input node
+        real const origin[3],        //!< Ray origin
+        real const inv_direction[3], //!< Inverse of the ray direction components
+        real t_max,                  //!< Maximum ray parameter
+        real &t_entry                //!< Ray parameter at the box entry
+    )
+    {
+      real t_min = 0.0;
+      for (size_t k = 0; k < 3; ++k)
+      {
+        if (std::isinf(inv_direction[k]))
+        {
+          if (origin[k] < node_in.min[k] || origin[k] > node_in.max[k])
+            return false;
+          continue;
+        }
+        real t_0 = (node_in.min[k] - origin[k]) * inv_direction[k];
+        real t_1 = (node_in.max[k] - origin[k]) * inv_direction[k];
+        if (t_0 > t_1)
+          std::swap(t_0, t_1);
+        t_min = std::max(t_min, t_0);
+        t_max = std::min(t_max, t_1);
+        if (t_min > t_max)
+          return false;
+      }
+      t_entry = t_min;
+      return true;
+    }
+
+  private:
+    //! Check if a transformed box overlaps a box on the axes of the frame of the latter
+    static bool
+    overlaps(
+        real const min0[3],          //!< Minimum point of box 0
+        real const max0[3],          //!< Maximum point of box 0
+        real const min1[3],          //!< Minimum point of box 1
+        real const max1[3],          //!< Maximum point of box 1
+        real const linear[3][3],     //!< Linear part from the box 1 frame to the box 0 frame
+        real const linear_abs[3][3], //!< Absolute values of the linear part
+        real const translation[3]    //!< Translation from the box 1 frame to the box 0 frame
+    )
+    {
+      real center1[3], extent1[3];
+      for (integer k = 0; k < 3; ++k)
       {
-        typename AABBtree::vecptr::const_iterator it1;
-        typename AABBtree::vecptr::const_iterator it2;
-        for (it1 = this->m_children.begin(); it1 != this->m_children.end(); ++it1)
-          for (it2 = tree.m_children.begin();
-               it2 != tree.m_children.end(); ++it2)
-            if ((*it1)->collision(**it2, function, swap_tree))
-              return true;
+        center1[k] = 0.5 * (min1[k] + max1[k]);
+        extent1[k] = 0.5 * (max1[k] - min1[k]);
       }
-      break;
+      for (integer k = 0; k < 3; ++k)
+      {
+        real center = translation[k] + linear[k][0] * center1[0] + linear[k][1] * center1[1] + linear[k][2] * center1[2];
+        real extent = linear_abs[k][0] * extent1[0] + linear_abs[k][1] * extent1[1] + linear_abs[k][2] * extent1[2];
+        if (std::abs(center - 0.5 * (min0[k] + max0[k])) > 0.5 * (max0[k] - min0[k]) + extent)
+          return false;
       }
+      return true;
+    }
+
+    //! Sum of the extents of the overlap of two AABB tree nodes
+    static real
+    overlap(
+        node const &node0, //!< Input node 0
+        node const &node1  //!< Input node 1
+    )
+    {
+      return std::min(node0.max[0], node1.max[0]) - std::max(node0.min[0], node1.min[0]) +
+             std::min(node0.max[1], node1.max[1]) - std::max(node0.min[1], node1.min[1]) +
+             std::min(node0.max[2], node1.max[2]) - std::max(node0.min[2], node1.min[2]);
+    }
+
+    //! Traverse the pairs of overlapping boxes of the subtrees rooted at two nodes
+    /**
+     * Iterative traversal on a local stack, shared by the collision and the
+     * intersection visit: the larger node of a pair is split and, when both
+     * trees are in the same frame, the child with the larger overlap is
+     * visited first, so that an early exit is more likely. When the stack is
+     * full the traversal recurses. The nodes and the boxes are tested in the
+     * frame given by the transformation, if any. The function receives the
+     * positions of the boxes in this and in the input tree and returns true
+     * to stop. Return true if the traversal has been stopped.
+     */
+    template <typename pair_function>
+    bool
+    traverse(
+        AABBtree const &tree,         //!< AABB tree used to check intersection
+        relative const *transform_in, //!< Transformation between the tree frames (nullptr if the same frame)
+        integer i,                    //!< Node index in this tree
+        integer j,                    //!< Node index in the input tree
+        pair_function &function       //!< Function called on each pair of box positions (true to stop)
+    ) const
+    {
+      integer stack_i[STACK_SIZE];
+      integer stack_j[STACK_SIZE];
+      integer top = 0;
+      size_t visited = 0;
+      size_t tested = 0;
+      size_t called = 0;
+      stack_i[top] = i;
+      stack_j[top] = j;
+      ++top;
+      while (top > 0)
+      {
+        --top;
+        i = stack_i[top];
+        j = stack_j[top];
+        node const &node_i = this->m_nodes[i];
+        node const &node_j = tree.m_nodes[j];
+        ++visited;
+        if (transform_in != nullptr ? !intersects(node_i, node_j, *transform_in)
+                                    : !intersects(node_i, node_j))
+          continue;
+
+        // both leaf, visit the overlapping boxes
+        if (node_i.count > 0 && node_j.count > 0)
+        {
+          tested += node_i.count * node_j.count;
+          for (integer a = node_i.index; a < node_i.index + node_i.count; ++a)
+          {
+            for (integer b = node_j.index; b < node_j.index + node_j.count; ++b)
+            {
+              if (node_i.count + node_j.count > 2)
+              {
+                aabb const &box_a = *this->m_boxes[a];
+                aabb const &box_b = *tree.m_boxes[b];
+                if (transform_in != nullptr ? !intersects(box_a.min().data(), box_a.max().data(),
+                                                          box_b.min().data(), box_b.max().data(), *transform_in)
+                                            : !box_a.intersects(box_b))
+                  continue;
+              }
+              ++called;
+              if (function(a, b))
+              {
+                this->count(visited, tested, called);
+                return true;
+              }
+            }
+          }
+          continue;
+        }
+
+        // split the larger node, in the same frame the child with the larger overlap goes first
+        integer first_i = i, first_j = j, second_i = i, second_j = j;
+        if (node_j.count > 0 || (node_i.count == 0 && area(node_i) >= area(node_j)))
+        {
+          first_i = i + 1;
+          second_i = node_i.index;
+          if (transform_in == nullptr &&
+              overlap(this->m_nodes[first_i], node_j) < overlap(this->m_nodes[second_i], node_j))
+            std::swap(first_i, second_i);
+        }
+        else
+        {
+          first_j = j + 1;
+          second_j = node_j.index;
+          if (transform_in == nullptr &&
+              overlap(node_i, tree.m_nodes[first_j]) < overlap(node_i, tree.m_nodes[second_j]))
+            std::swap(first_j, second_j);
+        }
+
+        if (top + 2 > STACK_SIZE)
+        {
+          // the local stack is full, visit the first pair on a new one
+          if (this->traverse(tree, transform_in, first_i, first_j, function))
+          {
+            this->count(visited, tested, called);
+            return true;
+          }
+          stack_i[top] = second_i;
+          stack_j[top] = second_j;
+          ++top;
+        }
+        else
+        {
+          stack_i[top] = second_i;
+          stack_j[top] = second_j;
+          ++top;
+          stack_i[top] = first_i;
+          stack_j[top] = first_j;
+          ++top;
+        }
+      }
+      this->count(visited, tested, called);
       return false;
     }
 
-    //! Compute all the intersection candidates of AABB trees
+    //! Cast a ray into the subtree rooted at a node
+    template <typename raycast_function>
+    bool
+    raycast(
+        real const origin[3],        //!< Ray origin
+        real const inv_direction[3], //!< Inverse of the ray direction components
+        integer i,                   //!< Node index
+        raycast_function function,   //!< Function to compute the ray parameter of the hit with the contents of an aabb
+        bool any_hit,                //!< If true stop at the first hit
+        aabb::ptr &boxOut,           //!< Hit box
+        real &tOut                   //!< Ray parameter of the hit (input maximum)
+    ) const
+    {
+      integer stack[STACK_SIZE];
+      real stack_t[STACK_SIZE];
+      integer top = 0;
+      bool hit = false;
+      real t_entry;
+      if (!intersects(this->m_nodes[i], origin, inv_direction, tOut, t_entry))
+        return false;
+      stack[top] = i;
+      stack_t[top] = t_entry;
+      ++top;
+      while (top > 0)
+      {
+        --top;
+        i = stack[top];
+        if (stack_t[top] > tOut)
+          continue;
+        node const &node_i = this->m_nodes[i];
+
+        if (node_i.count > 0)
+        {
+          for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+          {
+            if (function(this->m_boxes[b], tOut))
+            {
+              boxOut = this->m_boxes[b];
+              hit = true;
+              if (any_hit)
+                return true;
+            }
+          }
+          continue;
+        }
+
+        // the nearest child goes on top of the stack
+        integer near = i + 1;
+        integer far = node_i.index;
+        real t_near, t_far;
+        bool hit_near = intersects(this->m_nodes[near], origin, inv_direction, tOut, t_near);
+        bool hit_far = intersects(this->m_nodes[far], origin, inv_direction, tOut, t_far);
+        if (hit_near && hit_far && t_far < t_near)
+        {
+          std::swap(near, far);
+          std::swap(t_near, t_far);
+        }
+        else if (!hit_near)
+        {
+          near = far;
+          t_near = t_far;
+          hit_near = hit_far;
+          hit_far = false;
+        }
+        if (hit_far)
+        {
+          stack[top] = far;
+          stack_t[top] = t_far;
+          ++top;
+        }
+        if (hit_near)
+        {
+          if (top == STACK_SIZE)
+          {
+            // the local stack is full, visit the nearest child on a new one
+            if (this->raycast(origin, inv_direction, near, function, any_hit, boxOut, tOut))
+            {
+              hit = true;
+              if (any_hit)
+                return true;
+            }
+          }
+          else
+          {
+            stack[top] = near;
+            stack_t[top] = t_near;
+            ++top;
+          }
+        }
+      }
+      return hit;
+    }
+
+    //! Compute all the intersection candidates of the subtrees rooted at two nodes
     void
     intersection(
         AABBtree const &tree,               //!< AABB tree used to check collision
+        integer i,                          //!< Node index in this tree
+        integer j,                          //!< Node index in the input tree
         aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
-        bool swap_tree = false              //!< If true exchange the tree in computation
+        bool swap_tree                      //!< If true exchange the tree in computation
     ) const;
 
-  private:
-    //! Find the candidate at minimum distance from point
-    void selectMinimumDistance(
-        point const &query,         //!< Input point
+    //! Compute all the intersection candidates of the subtrees rooted at two nodes in different frames
+    void
+    intersection(
+        AABBtree const &tree,               //!< AABB tree used to check collision
+        relative const &transform_in,       //!< Transformation between the tree frames
+        integer i,                          //!< Node index in this tree
+        integer j,                          //!< Node index in the input tree
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool swap_tree                      //!< If true exchange the tree in computation
+    ) const;
+
+    //! Compute all the pairs of overlapping boxes of the subtrees rooted at two nodes (once if the same)
+    void
+    selfIntersection(
+        integer i,                         //!< First node index
+        integer j,                         //!< Second node index
+        aabb::vecpairptr &intersectionList //!< List of pair aabb that overlaps
+    ) const;
+
+    //! Compute all the boxes of the subtree rooted at a node that overlap a query node
+    void
+    intersection(
+        node const &query,          //!< Query node
+        integer i,                  //!< Node index
         aabb::vecptr &candidateList //!< Output candidate list
     ) const;
 
-    //! Compute the minimum of the maximum distance between a point
-    static real
-    minimumExteriorDistance(
-        point const &query,   //!< Input point
-        AABBtree const &tree, //!< Input tree
-        real distance         //!< Output distance
-    );
+    //! Compute all the boxes of the subtree rooted at a node hit by a ray
+    void
+    intersection(
+        real const origin[3],        //!< Ray origin
+        real const inv_direction[3], //!< Inverse of the ray direction components
+        integer i,                   //!< Node index
+        aabb::vecptr &candidateList  //!< Output candidate list
+    ) const;
 
-    //! Select the candidate which aabb have distance less than distance
-    static void
-    selectLessThanDistance(
-        point const &query,         //!< Input point
-        real distance,              //!< Input distance
-        AABBtree const &tree,       //!< Input tree
+    //! Compute all the boxes of the subtree rooted at a node that overlap a ball
+    void
+    intersection(
+        point const &center,        //!< Ball center
+        real radius,                //!< Ball radius
+        integer i,                  //!< Node index
         aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Classify the boxes of the subtree rooted at a node against a plane
+    void
+    halfSpace(
+        real const normal[3],       //!< Plane normal
+        real offset,                //!< Plane normal times plane origin
+        integer i,                  //!< Node index
+        aabb::vecptr *insideList,   //!< Output list of boxes in the half-space (skipped if null)
+        aabb::vecptr &candidateList //!< Output list of boxes straddling the plane
+    ) const;
+
+    //! Build the subtree of the boxes in the range [first, last) rooted at the i-th node
+    void
+    build(
+        integer first, //!< First box index
+        integer last,  //!< Last box index (excluded)
+        integer i      //!< Root node index
     );
 
+    //! Add to the query counters if they are enabled
+    void
+    count(
+        size_t nodes, //!< Number of nodes visited
+        size_t boxes, //!< Number of leaf box tests
+        size_t items  //!< Number of items reported
+    ) const;
+
+    //! Load the AABB tree from the content of a binary file
+    bool
+    load(
+        char const *data,         //!< File content
+        size_t size,              //!< File size in bytes
+        aabb::vecptr const &boxes //!< List of boxes used to build the saved tree
+    );
+
+    //! Build the AABB tree on the sorted Morton codes of the box centroids
+    void
+    buildLBVH(void);
+
+    //! Remove the unused nodes reserved for the ranges of the leaves with more than one box
+    void
+    compact(void);
+
+    //! Emit the subtree of the split k of the boxes in the range [first, last) rooted at the i-th node
+    void
+    emitLBVH(
+        std::vector<integer> const &left,  //!< Left child split of each split
+        std::vector<integer> const &right, //!< Right child split of each split
+        integer k,                         //!< Split index
+        integer first,                     //!< First box index
+        integer last,                      //!< Last box index (excluded)
+        integer i                          //!< Root node index
+    );
+
+    //! Split boxes at the midpoint of the longest axis of the node box
+    integer
+    splitMidpoint(
+        node const &parent, //!< Parent node
+        integer first,      //!< First box index
+        integer last        //!< Last box index (excluded)
+    );
+
+    //! Split boxes with the binned surface area heuristic
+    integer
+    splitSAH(
+        node const &parent, //!< Parent node
+        integer first,      //!< First box index
+        integer last,       //!< Last box index (excluded)
+        real &cost          //!< Cost of the best split (infinity if none)
+    );
+
+    //! Print the subtree rooted at a node
+    void
+    print(
+        out_stream &stream, //!< Output stream
+        integer i,          //!< Node index
+        integer level       //!< Level to print
+    ) const;
+
   }; // class AABBtree
 
 } // namespace acme
 
+#endif
+
 ///
 /// eof: acme_aabbTree.hh
 ///
\ No newline at end of file
@@ -209,6 +209,10 @@ namespace acme
         point const &point_in //!< Query point
     ) const;
 
+    //! Calculate aabb surface area
+    real
+    area(void) const;
+
     //! Resize the aabb as the minimum bounding aabb containing three input points
     void
     clamp(
@@ -36,8 +36,11 @@
 
 #include "acme.hh"
 #include "acme_AABBtree.hh"
+#include "acme_distance.hh"
 #include "acme_entity.hh"
 #include "acme_intersection.hh"
+#include "acme_pairCache.hh"
+#include "acme_sweep.hh"
 
 namespace acme
 {
@@ -57,6 +60,9 @@ namespace acme
    */
   class collection
   {
+  public:
+    typedef std::shared_ptr<collection> ptr; //!< Shared pointer to collection object
+
   private:
     entity::vecptr m_entities; //!< Vector of shared pointers to entity objects
     AABBtree::ptr m_AABBtree;  //!< Collection AABB tree pointer
@@ -424,6 +430,21 @@ namespace acme
     //! Build collection AABB tree
     void buildAABBtree(void);
 
+    //! Refit collection AABB tree to the moved entities keeping its topology
+    void refitAABBtree(void);
+
+    //! Save collection AABB tree to a binary file
+    bool
+    saveAABBtree(
+        std::string const &filename //!< Output file name
+    ) const;
+
+    //! Load collection AABB tree from a binary file saved on the same entities
+    bool
+    loadAABBtree(
+        std::string const &filename //!< Input file name
+    );
+
     //! Return collection AABB tree shared pointer
     AABBtree::ptr const &
     ptrAABBtree(void);
@@ -435,6 +456,35 @@ namespace acme
         collection &candidates //!< Intersection candidates
     ) const;
 
+    //! Intersect the collection with an external collection placed by an affine transformation
+    /**
+     * The external entities are in their own frame, mapped into the collection
+     * frame by the transformation, so the AABB tree of a rigid body is built
+     * once in body coordinates.
+     */
+    bool
+    intersection(
+        collection &entities,    //!< External entities collection
+        affine const &transform, //!< Transformation from the external collection frame to the collection frame
+        collection &candidates   //!< Intersection candidates
+    ) const;
+
+    //! Intersect the collection with an external collection through a persistent pair cache
+    /**
+     * The candidate pairs are found through the AABB trees as in the plain
+     * intersection with an external collection. The cache reports the pairs
+     * added, persisting and removed since its previous update, and reuses the
+     * intersections of the persisting pairs whose entities did not move. Only
+     * the actual intersections are returned.
+     */
+    bool
+    intersection(
+        collection &entities,      //!< External entities collection
+        pairCache &cache,          //!< Pair cache kept across the calls
+        collection &intersections, //!< Intersections of the candidate pairs
+        real tolerance = EPSILON   //!< Tolerance
+    ) const;
+
     //! Intersect the collection AABB tree with an external AABB tree
     bool intersection(
         AABBtree::ptr const &AABBtree, //!< External AABBtree object pointer
@@ -455,13 +505,115 @@ namespace acme
         collection &entities //!< Intersected entities vector list
     ) const;
 
-    //! Intersect all entities of the two collections
+    //! Find the entities within a distance from a point through the collection AABB tree
+    bool
+    within(
+        point const &query,           //!< Query point
+        real radius,                  //!< Query distance
+        std::vector<integer> &indices //!< Indices of the entities within distance (cleared first)
+    ) const;
+
+    //! Find the entities overlapping a ball through the collection AABB tree
+    bool
+    within(
+        ball const &ball_in,          //!< Query ball
+        std::vector<integer> &indices //!< Indices of the entities overlapping the ball (cleared first)
+    ) const;
+
+    //! Find the entities straddling a plane through the collection AABB tree
+    bool
+    slice(
+        plane const &plane_in,        //!< Slicing plane
+        std::vector<integer> &indices //!< Indices of the entities straddling the plane (cleared first)
+    ) const;
+
+    //! Find the entities lying in the half-space on the plane normal side through the collection AABB tree
+    bool
+    halfSpace(
+        plane const &plane_in,        //!< Plane bounding the half-space
+        std::vector<integer> &indices //!< Indices of the entities in the half-space (cleared first)
+    ) const;
+
+    //! Find the k entities nearest to a point through the collection AABB tree
+    bool
+    nearest(
+        point const &query,          //!< Query point
+        integer k,                   //!< Number of entities
+        collection &candidates,      //!< Nearest entities sorted by distance
+        std::vector<real> &distances //!< Distances of the nearest entities
+    ) const;
+
+    //! Find the entity closest to a point through the collection AABB tree
+    bool
+    closest(
+        point const &query,     //!< Query point
+        entity::ptr &entityOut, //!< Closest entity
+        real &distanceOut       //!< Distance of the closest entity
+    ) const;
+
+    //! Cast a ray into the collection through the collection AABB tree
+    /**
+     * Only triangles, disks and balls can be hit by the ray. The barycentric
+     * coordinates of the hit point are computed for triangles, for the other
+     * entities they are set to NaN.
+     */
+    bool
+    raycast(
+        ray const &ray_in,   //!< Input ray
+        integer &indexOut,   //!< Index of the hit entity
+        real &tOut,          //!< Ray parameter of the hit (origin + t * direction)
+        real &uOut,          //!< Barycentric coordinate u of the hit point
+        real &vOut,          //!< Barycentric coordinate v of the hit point
+        real &wOut,          //!< Barycentric coordinate w of the hit point
+        real t_max = INFTY,  //!< Maximum ray parameter
+        bool any_hit = false //!< If true return the first hit found (occlusion query)
+    ) const;
+
+    //! Intersect all the pairs of distinct entities of the collection with overlapping boxes
+    /**
+     * The candidate pairs (i < j) are found through the collection AABB tree,
+     * which is built on the fly if empty. Only the actual intersections are
+     * returned.
+     */
     void
     intersection(
-        collection &entities,    //!< Intersection candidates
+        collection &entities,    //!< Intersections
         real tolerance = EPSILON //!< Tolerance
     ) const;
 
+    //! Compute the earliest time of impact with an external collection, both moving between two poses
+    /**
+     * The swept boxes of the entities are checked through two AABB trees built
+     * on the fly, and the candidate pairs through conservative advancement.
+     * Only points, segments, triangles and balls are considered. Return true if
+     * any pair of entities collides before the end pose. The pairs for which
+     * the advancement does not converge (e.g. entities grazing each other) are
+     * reported at the lower bound of their time of impact, which is therefore
+     * conservative: the entities never come closer than the tolerance before
+     * the returned time.
+     */
+    bool
+    timeOfImpact(
+        affine const &start,          //!< Start pose of the collection
+        affine const &end,            //!< End pose of the collection
+        collection const &entities,   //!< External entities collection
+        affine const &entities_start, //!< Start pose of the external collection
+        affine const &entities_end,   //!< End pose of the external collection
+        integer &i,                   //!< Index of the colliding entity of the collection
+        integer &j,                   //!< Index of the colliding entity of the external collection
+        real &toi,                    //!< Earliest time of impact in [0,1]
+        real tolerance = EPSILON_LOW  //!< Contact distance tolerance
+    ) const;
+
+  private:
+    //! Build the swept boxes of the supported entities between two poses
+    void
+    sweptBoxes(
+        affine const &start, //!< Start pose
+        affine const &end,   //!< End pose
+        aabb::vecptr &boxes  //!< Output swept boxes (identifiers are the entity indices)
+    ) const;
+
   }; // class collection
 
 } // namespace acme
@@ -0,0 +1,148 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_distance.hh
+///
+
+#ifndef INCLUDE_ACME_DISTANCE
+#define INCLUDE_ACME_DISTANCE
+
+#include "acme.hh"
+#include "acme_ball.hh"
+#include "acme_disk.hh"
+#include "acme_line.hh"
+#include "acme_none.hh"
+#include "acme_plane.hh"
+#include "acme_point.hh"
+#include "acme_ray.hh"
+#include "acme_segment.hh"
+#include "acme_triangle.hh"
+
+namespace acme
+{
+
+  /*\
+   |   ____  _     _                       
+   |  |  _ \(_)___| |_ __ _ _ __   ___ ___ 
+   |  | | | | / __| __/ _` | '_ \ / __/ _ \
+   |  | |_| | \__ \ || (_| | | | | (_|  __/
+   |  |____/|_|___/\__\__,_|_| |_|\___\___|
+   |                                       
+  \*/
+
+  //! Distance between point and geometrical entity (infinite for none entities)
+  real
+  distance(
+      point const &point_in,  //!< Input point
+      entity const *entity_in //!< Input entity
+  );
+
+  //! Distance between two points
+  real
+  distance(
+      point const &point0_in, //!< Input point 0
+      point const &point1_in  //!< Input point 1
+  );
+
+  //! Distance between point and line
+  real
+  distance(
+      point const &point_in, //!< Input point
+      line const &line_in    //!< Input line
+  );
+
+  //! Distance between point and ray
+  real
+  distance(
+      point const &point_in, //!< Input point
+      ray const &ray_in      //!< Input ray
+  );
+
+  //! Distance between point and plane
+  real
+  distance(
+      point const &point_in, //!< Input point
+      plane const &plane_in  //!< Input plane
+  );
+
+  //! Distance between point and segment
+  real
+  distance(
+      point const &point_in,    //!< Input point
+      segment const &segment_in //!< Input segment
+  );
+
+  //! Distance between point and triangle
+  real
+  distance(
+      point const &point_in,      //!< Input point
+      triangle const &triangle_in //!< Input triangle
+  );
+
+  //! Distance between point and disk
+  real
+  distance(
+      point const &point_in, //!< Input point
+      disk const &disk_in    //!< Input disk
+  );
+
+  //! Distance between point and ball (zero inside the ball)
+  real
+  distance(
+      point const &point_in, //!< Input point
+      ball const &ball_in    //!< Input ball
+  );
+
+  //! Distance between two segments
+  real
+  distance(
+      segment const &segment0_in, //!< Input segment 0
+      segment const &segment1_in  //!< Input segment 1
+  );
+
+  //! Distance between segment and triangle (zero if the segment crosses the triangle)
+  real
+  distance(
+      segment const &segment_in,  //!< Input segment
+      triangle const &triangle_in //!< Input triangle
+  );
+
+  //! Distance between two triangles (zero if the triangles intersect)
+  real
+  distance(
+      triangle const &triangle0_in, //!< Input triangle 0
+      triangle const &triangle1_in  //!< Input triangle 1
+  );
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_distance.hh
+///
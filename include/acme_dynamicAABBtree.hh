@@ -0,0 +1,275 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_dynamicAABBtree.hh
+///
+
+#ifndef INCLUDE_ACME_DYNAMICAABBTREE
+#define INCLUDE_ACME_DYNAMICAABBTREE
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+
+namespace acme
+{
+
+  /*\
+   |       _                             _         _        _    ____  ____  _                 
+   |    __| |_   _ _ __   __ _ _ __ ___ (_) ___   / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |   / _` | | | | '_ \ / _` | '_ ` _ \| |/ __| / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |  | (_| | |_| | | | | (_| | | | | | | | (__ / ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |   \__,_|\__, |_| |_|\__,_|_| |_| |_|_|\___/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |         |___/                                                                             
+  \*/
+
+  //! Dynamic axis-aligned bouding box tree class container
+  /**
+   * Axis-aligned bouding box tree supporting insertion, removal and motion of
+   * single boxes. Leaves store boxes fattened by a margin, so that small motions
+   * of a box do not require any update of the tree, and the tree is kept
+   * balanced with rotations after every insertion and removal.
+  */
+  class dynamicAABBtree
+  {
+  public:
+    typedef std::shared_ptr<dynamicAABBtree> ptr; //!< Shared pointer to dynamic AABB tree object
+
+    //! Dynamic AABB tree node
+    struct node
+    {
+      real min[3];    //!< Node (fattened) box minimum point
+      real max[3];    //!< Node (fattened) box maximum point
+      integer parent; //!< Parent node index (next free node index if the node is free)
+      integer left;   //!< Left child node index (-1 for leaves)
+      integer right;  //!< Right child node index (-1 for leaves)
+      integer height; //!< Height of the subtree (zero for leaves, -1 for free nodes)
+    };
+
+    typedef std::vector<node> vecnode; //!< Vector of dynamic AABB tree nodes
+
+  private:
+    vecnode m_nodes;      //!< Tree nodes (free nodes are linked in a list)
+    aabb::vecptr m_boxes; //!< Boxes of the leaves (indexed as the nodes)
+    integer m_root;       //!< Root node index (-1 if the tree is empty)
+    integer m_free;       //!< First free node index (-1 if there are none)
+    integer m_size;       //!< Number of boxes in the tree
+    real m_margin;        //!< Margin used to fatten the leaf boxes
+
+    dynamicAABBtree(dynamicAABBtree const &tree);
+
+  public:
+    //! Dynamic AABB tree class destructor
+    ~dynamicAABBtree();
+
+    //! Dynamic AABB tree class constructor
+    dynamicAABBtree(
+        real margin = 0.1 //!< Margin used to fatten the leaf boxes
+    );
+
+    //! Clear dynamic AABB tree data
+    void
+    clear(void);
+
+    //! Check if dynamic AABB tree is empty
+    bool
+    isEmpty(void) const;
+
+    //! Get number of boxes in the dynamic AABB tree
+    integer
+    size(void) const;
+
+    //! Get dynamic AABB tree height
+    integer
+    height(void) const;
+
+    //! Get margin used to fatten the leaf boxes
+    real
+    margin(void) const;
+
+    //! Insert a box in the dynamic AABB tree and return its identifier
+    integer
+    insert(
+        aabb::ptr const &box //!< Input box
+    );
+
+    //! Remove a box from the dynamic AABB tree
+    void
+    remove(
+        integer id //!< Box identifier
+    );
+
+    //! Move a box, return true if the tree has been updated
+    bool
+    move(
+        integer id,          //!< Box identifier
+        aabb::ptr const &box //!< Moved box
+    );
+
+    //! Get box given its identifier
+    aabb::ptr const &
+    box(
+        integer id //!< Box identifier
+    ) const;
+
+    //! Get dynamic AABB tree nodes const reference
+    vecnode const &
+    nodes(void) const;
+
+    //! Check if the dynamic AABB tree collides with an AABB tree
+    template <typename collision_function>
+    bool
+    collision(
+        AABBtree const &tree,        //!< AABB tree used to check collision
+        collision_function function, //!< Function to check if the contents of two aabb collide
+        bool swap_tree = false       //!< If true exchange the tree in computation
+    ) const
+    {
+      if (this->isEmpty() || tree.isEmpty())
+        return false;
+      AABBtree::vecnode const &tree_nodes = tree.nodes();
+      aabb::vecptr const &tree_boxes = tree.boxes();
+      std::vector<std::pair<integer, integer>> stack;
+      stack.push_back(std::make_pair(this->m_root, 0));
+      while (!stack.empty())
+      {
+        integer i = stack.back().first;
+        integer j = stack.back().second;
+        stack.pop_back();
+        node const &node_i = this->m_nodes[i];
+        AABBtree::node const &node_j = tree_nodes[j];
+        if (!intersects(node_i, node_j))
+          continue;
+        if (node_i.left < 0 && node_j.count > 0)
+        {
+          for (integer b = node_j.index; b < node_j.index + node_j.count; ++b)
+          {
+            if (!this->m_boxes[i]->intersects(*tree_boxes[b]))
+              continue;
+            if (swap_tree ? function(tree_boxes[b], this->m_boxes[i])
+                          : function(this->m_boxes[i], tree_boxes[b]))
+              return true;
+          }
+        }
+        else if (node_j.count > 0 || (node_i.left >= 0 && area(node_i) >= AABBtree::area(node_j)))
+        {
+          stack.push_back(std::make_pair(node_i.right, j));
+          stack.push_back(std::make_pair(node_i.left, j));
+        }
+        else
+        {
+          stack.push_back(std::make_pair(i, node_j.index));
+          stack.push_back(std::make_pair(i, j + 1));
+        }
+      }
+      return false;
+    }
+
+    //! Compute all the intersection candidates with an AABB tree
+    void
+    intersection(
+        AABBtree const &tree,               //!< AABB tree used to check collision
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool swap_tree = false              //!< If true exchange the tree in computation
+    ) const;
+
+    //! Compute all the boxes overlapping a box
+    void
+    intersection(
+        aabb const &box_in,         //!< Input box
+        aabb::vecptr &candidateList //!< List of the overlapping boxes
+    ) const;
+
+  private:
+    //! Allocate a node
+    integer
+    allocate(void);
+
+    //! Release a node
+    void
+    release(
+        integer i //!< Node index
+    );
+
+    //! Insert a leaf in the tree
+    void
+    insertLeaf(
+        integer leaf //!< Leaf node index
+    );
+
+    //! Remove a leaf from the tree
+    void
+    removeLeaf(
+        integer leaf //!< Leaf node index
+    );
+
+    //! Refit box and height of the ancestors of a node, rebalancing the tree
+    void
+    refit(
+        integer i //!< Node index
+    );
+
+    //! Rebalance the subtree rooted at a node with a rotation and return its new root
+    integer
+    balance(
+        integer i //!< Node index
+    );
+
+    //! Merge the boxes of the children of a node and update its height
+    void
+    merge(
+        integer i //!< Node index
+    );
+
+    //! Surface area of a node box
+    static real
+    area(
+        node const &node_in //!< Input node
+    );
+
+    //! Check if a dynamic AABB tree node and an AABB tree node overlap
+    static bool
+    intersects(
+        node const &node0,          //!< Input dynamic AABB tree node
+        AABBtree::node const &node1 //!< Input AABB tree node
+    )
+    {
+      return node0.min[0] <= node1.max[0] && node0.max[0] >= node1.min[0] &&
+             node0.min[1] <= node1.max[1] && node0.max[1] >= node1.min[1] &&
+             node0.min[2] <= node1.max[2] && node0.max[2] >= node1.min[2];
+    }
+
+  }; // class dynamicAABBtree
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_dynamicAABBtree.hh
+///
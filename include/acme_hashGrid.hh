@@ -0,0 +1,177 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_hashGrid.hh
+///
+
+#ifndef INCLUDE_ACME_HASHGRID
+#define INCLUDE_ACME_HASHGRID
+
+#include <cstdint>
+
+#include "acme.hh"
+#include "acme_aabb.hh"
+
+namespace acme
+{
+
+  /*\
+   |   _               _      ____      _     _ 
+   |  | |__   __ _ ___| |__  / ___|_ __(_) __| |
+   |  | '_ \ / _` / __| '_ \| |  _| '__| |/ _` |
+   |  | | | | (_| \__ \ | | | |_| | |  | | (_| |
+   |  |_| |_|\__,_|___/_| |_|\____|_|  |_|\__,_|
+   |                                            
+  \*/
+
+  //! Uniform spatial hash grid class container
+  /**
+   * Broadphase alternative to the AABB trees for many similarly sized boxes.
+   * Every box is inserted in all the cells of a uniform grid it overlaps, the
+   * cells are hashed on their integer coordinates and the entries are sorted
+   * by cell key, so that the boxes of a cell are contiguous. A pair of boxes
+   * is reported only in the cell containing the minimum point of their
+   * overlap, so no pair is ever reported twice. The cell size should be about
+   * the size of the largest boxes, since larger boxes span many cells. The
+   * boxes spanning too many cells, lying too far from the origin or with
+   * non-finite coordinates are kept out of the grid and checked against all
+   * the other boxes.
+  */
+  class hashGrid
+  {
+  public:
+    typedef std::shared_ptr<hashGrid> ptr; //!< Shared pointer to hash grid object
+
+  private:
+    real m_cell_size;               //!< Size of the grid cells
+    aabb::vecptr m_boxes;           //!< Grid boxes in the input order
+    std::vector<uint64_t> m_keys;   //!< Cell keys of the entries sorted by key
+    std::vector<integer> m_entries; //!< Box indices of the entries sorted by key
+    std::vector<integer> m_large;   //!< Indices of the boxes kept out of the grid
+
+    hashGrid(hashGrid const &grid);
+
+  public:
+    //! Hash grid class destructor
+    ~hashGrid();
+
+    //! Hash grid class constructor
+    hashGrid(
+        real cell_size = 1.0 //!< Size of the grid cells
+    );
+
+    //! Clear hash grid data
+    void
+    clear(void);
+
+    //! Check if hash grid is empty
+    bool
+    isEmpty(void) const;
+
+    //! Set size of the grid cells (the hash grid is cleared)
+    void
+    setCellSize(
+        real cell_size //!< Size of the grid cells
+    );
+
+    //! Get size of the grid cells
+    real
+    cellSize(void) const;
+
+    //! Build hash grid given a list of boxes (the boxes are inserted in parallel)
+    void
+    build(
+        aabb::vecptr const &boxes //!< List of boxes
+    );
+
+    //! Get hash grid boxes const reference
+    aabb::vecptr const &
+    boxes(void) const;
+
+    //! Get number of non-empty cells
+    integer
+    cells(void) const;
+
+    //! Compute all the pairs of overlapping boxes of two hash grids with the same cell size
+    void
+    intersection(
+        hashGrid const &grid,               //!< Hash grid used to check collision
+        aabb::vecpairptr &intersectionList, //!< List of pair aabb that overlaps
+        bool swap_grid = false              //!< If true exchange the grid in computation
+    ) const;
+
+    //! Compute all the pairs of overlapping boxes of the hash grid
+    void
+    selfIntersection(
+        aabb::vecpairptr &intersectionList //!< List of pair aabb that overlaps
+    ) const;
+
+    //! Compute all the grid boxes that overlap an external box
+    void
+    intersection(
+        aabb const &box,            //!< Input box
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+  private:
+    //! Check if a box must be kept out of the grid
+    bool
+    isLarge(
+        aabb const &box //!< Input box
+    ) const;
+
+    //! Integer coordinate of the cell containing a coordinate
+    int64_t
+    cell(
+        real coordinate //!< Input coordinate
+    ) const;
+
+    //! Key of the cell of given integer coordinates
+    static uint64_t
+    key(
+        int64_t x, //!< Cell x coordinate
+        int64_t y, //!< Cell y coordinate
+        int64_t z  //!< Cell z coordinate
+    );
+
+    //! Key of the cell containing the minimum point of the overlap of two boxes
+    uint64_t
+    overlapKey(
+        aabb const &box0, //!< Input box 0
+        aabb const &box1  //!< Input box 1
+    ) const;
+
+  }; // class hashGrid
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_hashGrid.hh
+///
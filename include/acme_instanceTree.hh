@@ -0,0 +1,195 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_instanceTree.hh
+///
+
+#ifndef INCLUDE_ACME_INSTANCETREE
+#define INCLUDE_ACME_INSTANCETREE
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_collection.hh"
+#include "acme_ray.hh"
+
+namespace acme
+{
+
+  /*\
+   |   _           _                      _____              
+   |  (_)_ __  ___| |_ __ _ _ __   ___ __|_   _| __ ___  ___ 
+   |  | | '_ \/ __| __/ _` | '_ \ / __/ _ \| || '__/ _ \/ _ \
+   |  | | | | \__ \ || (_| | | | | (_|  __/| || | |  __/  __/
+   |  |_|_| |_|___/\__\__,_|_| |_|\___\___||_||_|  \___|\___|
+   |                                                         
+  \*/
+
+  //! Two-level instanced AABB tree class container
+  /**
+   * Every instance places a shared mesh, a collection with its own AABB tree
+   * built once in the mesh frame, in the scene through an affine
+   * transformation. The top-level AABB tree is built on the scene boxes of the
+   * instances. The queries traverse the top-level tree, then transform the
+   * query into the frame of every instance reached and traverse the mesh tree.
+   * The memory and the rebuild time grow with the number of instances, not
+   * with the number of entities placed in the scene. An instance is the exact
+   * affine image of its mesh, so a scaling also scales the balls and disks.
+  */
+  class instanceTree
+  {
+  public:
+    typedef std::shared_ptr<instanceTree> ptr;                //!< Shared pointer to instance tree object
+    typedef std::vector<std::pair<integer, integer>> vecpair; //!< Vector of pairs of instance and entity indices
+
+    //! Instance of a mesh in the scene
+    struct instance
+    {
+      collection::ptr mesh; //!< Mesh entities in the mesh frame
+      affine transform;     //!< Transformation from the mesh frame to the scene frame
+      affine inverse;       //!< Transformation from the scene frame to the mesh frame
+    };
+
+    typedef std::vector<instance> vecinstance; //!< Vector of instances
+
+  private:
+    vecinstance m_instances; //!< Instances of the meshes
+    aabb::vecptr m_boxes;    //!< Scene boxes of the instances
+    AABBtree m_tree;         //!< Top-level AABB tree on the instance boxes
+
+    instanceTree(instanceTree const &tree);
+
+  public:
+    //! Instance tree class destructor
+    ~instanceTree();
+
+    //! Instance tree class constructor
+    instanceTree();
+
+    //! Clear instance tree data
+    void
+    clear(void);
+
+    //! Check if instance tree is empty
+    bool
+    isEmpty(void) const;
+
+    //! Get number of instances
+    integer
+    size(void) const;
+
+    //! Add an instance of a mesh and return its index
+    /**
+     * The mesh AABB tree is built if empty, and it is shared by all the
+     * instances of the mesh. The top-level tree must be built again.
+     */
+    integer
+    add(
+        collection::ptr const &mesh, //!< Mesh entities in the mesh frame
+        affine const &transform      //!< Transformation from the mesh frame to the scene frame
+    );
+
+    //! Get the i-th instance const reference
+    instance const &
+    getInstance(
+        integer i //!< Instance index
+    ) const;
+
+    //! Set the transformation of the i-th instance (the top-level tree must be refitted)
+    void
+    setTransform(
+        integer i,              //!< Instance index
+        affine const &transform //!< Transformation from the mesh frame to the scene frame
+    );
+
+    //! Build the top-level AABB tree on the scene boxes of the instances
+    void
+    build(void);
+
+    //! Refit the top-level AABB tree to the moved instances keeping its topology
+    void
+    refit(void);
+
+    //! Get the top-level AABB tree const reference
+    AABBtree const &
+    tree(void) const;
+
+    //! Compute all the entity boxes that overlap an external box
+    /**
+     * The box is moved into the frame of every instance as the box of its
+     * transformed corners, then the mesh boxes found are checked against the
+     * query as oriented boxes. The candidates are conservative.
+     */
+    void
+    intersection(
+        aabb const &box,       //!< Input box in the scene frame
+        vecpair &candidateList //!< Output list of instance and entity indices
+    ) const;
+
+    //! Compute all the entity boxes hit by a ray
+    void
+    intersection(
+        ray const &ray_in,     //!< Input ray in the scene frame
+        vecpair &candidateList //!< Output list of instance and entity indices
+    ) const;
+
+    //! Cast a ray into the instances
+    /**
+     * The ray is moved into the frame of every instance with its direction not
+     * normalized, so the ray parameter of the hits is the same in the mesh and
+     * in the scene frames. The hits are computed as in the collection raycast.
+     */
+    bool
+    raycast(
+        ray const &ray_in,    //!< Input ray in the scene frame
+        integer &instanceOut, //!< Index of the hit instance
+        integer &indexOut,    //!< Index of the hit entity in the instance mesh
+        real &tOut,           //!< Ray parameter of the hit (origin + t * direction)
+        real &uOut,           //!< Barycentric coordinate u of the hit point
+        real &vOut,           //!< Barycentric coordinate v of the hit point
+        real &wOut,           //!< Barycentric coordinate w of the hit point
+        real t_max = INFTY,   //!< Maximum ray parameter
+        bool any_hit = false  //!< If true return the first hit found (occlusion query)
+    ) const;
+
+  private:
+    //! Compute the scene box of the i-th instance
+    aabb::ptr
+    instanceBox(
+        integer i //!< Instance index
+    ) const;
+
+  }; // class instanceTree
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_instanceTree.hh
+///
@@ -0,0 +1,211 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_pairCache.hh
+///
+
+#ifndef INCLUDE_ACME_PAIRCACHE
+#define INCLUDE_ACME_PAIRCACHE
+
+
+#include <cstdint>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_entity.hh"
+#include "acme_intersection.hh"
+
+namespace acme
+{
+
+  /*\
+   |               _       ____           _          
+   |   _ __   __ _(_)_ __ / ___|__ _  ___| |__   ___ 
+   |  | '_ \ / _` | | '__| |   / _` |/ __| '_ \ / _ \
+   |  | |_) | (_| | | |  | |__| (_| | (__| | | |  __/
+   |  | .__/ \__,_|_|_|   \____\__,_|\___|_| |_|\___|
+   |  |_|                                            
+  \*/
+
+  //! Persistent contact pair cache class container
+  /**
+   * Cache of the candidate pairs of entities of two collections, kept across
+   * the simulation steps as a list sorted by the pair of entity indices. Every
+   * update merges the sorted candidates of the new step with the cached pairs,
+   * and reports the pairs added, persisting and removed since the previous
+   * update. The geometric state of the entities is recorded at every update,
+   * so the intersection of a persisting pair is reused as long as both of its
+   * entities did not move.
+  */
+  class pairCache
+  {
+  public:
+    typedef std::shared_ptr<pairCache> ptr;                   //!< Shared pointer to pair cache object
+    typedef std::vector<std::pair<integer, integer>> vecpair; //!< Vector of pairs of entity indices
+
+    static integer const STATE_SIZE = 10; //!< Number of values of the geometric state of an entity
+
+    //! Cached pair of entities
+    struct contact
+    {
+      integer first;            //!< Entity index of the first collection
+      integer second;           //!< Entity index of the second collection
+      entity::ptr intersection; //!< Intersection of the entities
+    };
+
+    typedef std::vector<contact> veccontact; //!< Vector of cached pairs of entities
+
+  private:
+    veccontact m_contacts;            //!< Cached pairs sorted by entity indices
+    veccontact m_merged;              //!< Cached pairs merged by the update (buffer)
+    aabb::vecpairptr m_boxes;         //!< Candidate pairs of boxes of the broadphase (buffer)
+    std::vector<uint64_t> m_keys;     //!< Sorted keys of the candidate pairs (buffer)
+    std::vector<uint64_t> m_sorting;  //!< Keys of the candidate pairs being sorted (buffer)
+    vecpair m_added;                  //!< Pairs added by the last update
+    vecpair m_persisting;             //!< Pairs persisting through the last update
+    vecpair m_removed;                //!< Pairs removed by the last update
+    std::vector<real> m_states[2];    //!< Geometric states of the entities of the two collections
+    std::vector<size_t> m_checked[2]; //!< Last update in which the entities state was checked
+    std::vector<bool> m_moved[2];     //!< Entities moved since the previous check
+    size_t m_step;                    //!< Number of updates
+    size_t m_computed;                //!< Number of intersections computed by the last update
+    real m_tolerance;                 //!< Tolerance of the cached intersections
+
+    pairCache(pairCache const &cache);
+
+  public:
+    //! Pair cache class destructor
+    ~pairCache();
+
+    //! Pair cache class constructor
+    pairCache();
+
+    //! Clear pair cache data
+    void
+    clear(void);
+
+    //! Check if pair cache is empty
+    bool
+    isEmpty(void) const;
+
+    //! Get number of cached pairs
+    integer
+    size(void) const;
+
+    //! Update the pair cache with the candidate pairs of a new step
+    /**
+     * The intersections of the added pairs, and of the persisting pairs with a
+     * moved entity, are computed. The pairs that are no more candidates are
+     * removed from the cache. The reported pairs are sorted by entity indices.
+     */
+    void
+    update(
+        entity::vecptr const &entities0, //!< Entities of the first collection
+        entity::vecptr const &entities1, //!< Entities of the second collection
+        vecpair const &candidates,       //!< Candidate pairs of entity indices
+        real tolerance = EPSILON         //!< Intersection tolerance
+    );
+
+    //! Update the pair cache with the overlapping boxes of the AABB trees of a new step
+    /**
+     * The box identifiers must be the entity indices. The broadphase writes the
+     * candidate pairs in a buffer of the cache, so that no memory is allocated
+     * once the buffers fit the candidates of a step.
+     */
+    void
+    update(
+        entity::vecptr const &entities0, //!< Entities of the first collection
+        entity::vecptr const &entities1, //!< Entities of the second collection
+        AABBtree const &tree0,           //!< AABB tree of the first collection
+        AABBtree const &tree1,           //!< AABB tree of the second collection
+        real tolerance = EPSILON         //!< Intersection tolerance
+    );
+
+    //! Get the cached pairs sorted by entity indices
+    veccontact const &
+    contacts(void) const;
+
+    //! Get the pairs added by the last update
+    vecpair const &
+    added(void) const;
+
+    //! Get the pairs persisting through the last update
+    vecpair const &
+    persisting(void) const;
+
+    //! Get the pairs removed by the last update
+    vecpair const &
+    removed(void) const;
+
+    //! Get the number of intersections computed by the last update
+    size_t
+    computed(void) const;
+
+    //! Get the cached intersection of a pair (null if the pair is not cached)
+    entity::ptr
+    intersection(
+        integer i, //!< Entity index of the first collection
+        integer j  //!< Entity index of the second collection
+    ) const;
+
+  private:
+    //! Merge the sorted candidate keys with the cached pairs
+    void
+    merge(
+        entity::vecptr const &entities0, //!< Entities of the first collection
+        entity::vecptr const &entities1, //!< Entities of the second collection
+        real tolerance                   //!< Intersection tolerance
+    );
+
+    //! Check if an entity moved since the previous update, recording its state once per update
+    bool
+    moved(
+        entity const *entity_in, //!< Input entity
+        integer side,            //!< Collection of the entity (0 or 1)
+        integer i                //!< Entity index
+    );
+
+    //! Key of a pair of entities, ordered as the pair of entity indices
+    static uint64_t
+    key(
+        integer i, //!< Entity index of the first collection
+        integer j  //!< Entity index of the second collection
+    )
+    {
+      return uint64_t(uint32_t(i)) << 32 | uint64_t(uint32_t(j));
+    }
+
+  }; // class pairCache
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_pairCache.hh
+///
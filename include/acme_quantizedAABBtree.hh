@@ -0,0 +1,199 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_quantizedAABBtree.hh
+///
+
+#ifndef INCLUDE_ACME_QUANTIZEDAABBTREE
+#define INCLUDE_ACME_QUANTIZEDAABBTREE
+
+#include <cstdint>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_ray.hh"
+
+namespace acme
+{
+
+  /*\
+   |                           _   _             _    _        _    ____  ____  _                 
+   |    __ _ _   _  __ _ _ __ | |_(_)_______  __| |  / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |   / _` | | | |/ _` | '_ \| __| |_  / _ \/ _` | / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |  | (_| | |_| | (_| | | | | |_| |/ /  __/ (_| |/ ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |   \__, |\__,_|\__,_|_| |_|\__|_/___\___|\__,_/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |      |_|                                                                                     
+  \*/
+
+  //! Quantized axis-aligned bouding box tree class container
+  /**
+   * Memory-compact copy of a binary AABB tree. The box of every node is stored
+   * as 8-bit or 16-bit integer offsets relative to the box of its parent, and
+   * it is dequantized on the fly during the traversal. The quantization rounds
+   * outwards and is checked against the dequantization itself, so the node
+   * boxes are conservative: no overlap is ever missed.
+  */
+  class quantizedAABBtree
+  {
+  public:
+    typedef std::shared_ptr<quantizedAABBtree> ptr; //!< Shared pointer to quantized AABB tree object
+
+    //! Quantized AABB tree node topology
+    struct node
+    {
+      integer index; //!< Right child index (inner node) or first box index (leaf)
+      integer count; //!< Number of boxes in the leaf (zero for inner nodes)
+    };
+
+    typedef std::vector<node> vecnode; //!< Vector of quantized AABB tree nodes
+
+  private:
+    static integer const STACK_SIZE = 64; //!< Size of the local stack of the traversal kernels
+
+    vecnode m_nodes;               //!< Tree nodes in depth-first order (root first)
+    std::vector<uint8_t> m_bounds; //!< Quantized node boxes (minimum and maximum offsets per axis)
+    aabb::vecptr m_boxes;          //!< Tree boxes sorted by leaf
+    AABBtree::node m_root;         //!< Root box
+    integer m_bits;                //!< Number of bits of the quantized offsets (8 or 16)
+
+    quantizedAABBtree(quantizedAABBtree const &tree);
+
+  public:
+    //! Quantized AABB tree class destructor
+    ~quantizedAABBtree();
+
+    //! Quantized AABB tree class constructor
+    quantizedAABBtree(
+        integer bits = 16 //!< Number of bits of the quantized offsets (8 or 16)
+    );
+
+    //! Clear quantized AABB tree data
+    void
+    clear(void);
+
+    //! Check if quantized AABB tree is empty
+    bool
+    isEmpty(void) const;
+
+    //! Get number of bits of the quantized offsets
+    integer
+    bits(void) const;
+
+    //! Build quantized AABB tree from a binary AABB tree
+    void
+    build(
+        AABBtree const &tree //!< Input binary AABB tree
+    );
+
+    //! Get memory used by the tree nodes in bytes (boxes excluded)
+    size_t
+    memory(void) const;
+
+    //! Get quantized AABB tree boxes (sorted by leaf) const reference
+    aabb::vecptr const &
+    boxes(void) const;
+
+    //! Dequantize the box of a node
+    AABBtree::node
+    nodeBox(
+        integer i //!< Node index
+    ) const;
+
+    //! Compute all the tree boxes that overlap an external box
+    void
+    intersection(
+        aabb const &box,            //!< Input box
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Compute all the tree boxes hit by a ray
+    void
+    intersection(
+        ray const &ray_in,          //!< Input ray
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+  private:
+    //! Get the i-th quantized offset
+    integer
+    offset(
+        size_t i //!< Offset index
+    ) const;
+
+    //! Set the i-th quantized offset
+    void
+    offset(
+        size_t i,     //!< Offset index
+        integer value //!< Offset value
+    );
+
+    //! Dequantize the box of a node given the box of its parent
+    void
+    dequantize(
+        integer i,                    //!< Node index
+        AABBtree::node const &parent, //!< Parent box
+        AABBtree::node &box           //!< Output node box
+    ) const;
+
+    //! Quantize the subtree of a binary AABB tree rooted at a node given its dequantized box
+    void
+    quantize(
+        AABBtree::vecnode const &nodes, //!< Binary AABB tree nodes
+        integer i,                      //!< Node index
+        AABBtree::node const &box       //!< Dequantized node box
+    );
+
+    //! Compute all the boxes of the subtree rooted at a node that overlap a query box
+    void
+    boxIntersection(
+        AABBtree::node const &query, //!< Query box
+        integer i,                   //!< Node index
+        AABBtree::node const &box,   //!< Dequantized node box
+        aabb::vecptr &candidateList  //!< Output candidate list
+    ) const;
+
+    //! Compute all the boxes of the subtree rooted at a node hit by a ray
+    void
+    rayIntersection(
+        real const origin[3],        //!< Ray origin
+        real const inv_direction[3], //!< Inverse of the ray direction components
+        integer i,                   //!< Node index
+        AABBtree::node const &box,   //!< Dequantized node box
+        aabb::vecptr &candidateList  //!< Output candidate list
+    ) const;
+
+  }; // class quantizedAABBtree
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_quantizedAABBtree.hh
+///
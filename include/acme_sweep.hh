@@ -0,0 +1,99 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_sweep.hh
+///
+
+#ifndef INCLUDE_ACME_SWEEP
+#define INCLUDE_ACME_SWEEP
+
+#include "acme.hh"
+#include "acme_aabb.hh"
+#include "acme_distance.hh"
+
+namespace acme
+{
+
+  /*\
+   |   ____                         
+   |  / ___|_      _____  ___ _ __  
+   |  \___ \ \ /\ / / _ \/ _ \ '_ \ 
+   |   ___) \ V  V /  __/  __/ |_) |
+   |  |____/ \_/\_/ \___|\___| .__/ 
+   |                         |_|    
+  \*/
+
+  //! Compute the box bounding an entity moving between two poses
+  /**
+   * The vertices of the entity move linearly from the start to the end pose,
+   * so the box of the vertices in the two poses bounds the whole motion. Only
+   * points, segments, triangles and balls are supported, return false for the
+   * other entities.
+   */
+  bool
+  sweep(
+      entity const *entity_in, //!< Input entity
+      affine const &start,     //!< Start pose
+      affine const &end,       //!< End pose
+      aabb &box                //!< Output swept box
+  );
+
+  //! Compute the time of impact of two entities moving between two poses
+  /**
+   * The vertices of the entities move linearly from the start (time zero) to
+   * the end pose (time one), which approximates rigid motions with small
+   * rotations. The time of impact is found by conservative advancement: the
+   * distance of the entities changes at most by the sum of their fastest
+   * vertex speeds, so advancing by the distance over that speed never steps
+   * through a contact, not even of thin entities. Only points, segments,
+   * triangles and balls are supported. Return true if the entities come
+   * within the tolerance before the maximum time. Return false otherwise: the
+   * time is infinite if the entities do not collide before the maximum time,
+   * or it is a lower bound of the time of impact if the advancement does not
+   * converge (e.g. for entities grazing each other within a short distance).
+   */
+  bool
+  timeOfImpact(
+      entity const *entity0_in,    //!< Input entity 0
+      affine const &start0,        //!< Start pose of entity 0
+      affine const &end0,          //!< End pose of entity 0
+      entity const *entity1_in,    //!< Input entity 1
+      affine const &start1,        //!< Start pose of entity 1
+      affine const &end1,          //!< End pose of entity 1
+      real &toi,                   //!< Output time of impact
+      real t_max = 1.0,            //!< Maximum time
+      real tolerance = EPSILON_LOW //!< Contact distance tolerance
+  );
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_sweep.hh
+///
@@ -0,0 +1,182 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_sweepAndPrune.hh
+///
+
+#ifndef INCLUDE_ACME_SWEEPANDPRUNE
+#define INCLUDE_ACME_SWEEPANDPRUNE
+
+#include <cstdint>
+#include <unordered_set>
+
+#include "acme.hh"
+#include "acme_aabb.hh"
+
+namespace acme
+{
+
+  /*\
+   |                                 _              _ ____                        
+   |   _____      _____  ___ _ __   / \   _ __   __| |  _ \ _ __ _   _ _ __   ___ 
+   |  / __\ \ /\ / / _ \/ _ \ '_ \ / _ \ | '_ \ / _` | |_) | '__| | | | '_ \ / _ \
+   |  \__ \\ V  V /  __/  __/ |_) / ___ \| | | | (_| |  __/| |  | |_| | | | |  __/
+   |  |___/ \_/\_/ \___|\___| .__/_/   \_\_| |_|\__,_|_|   |_|   \__,_|_| |_|\___|
+   |                        |_|                                                   
+  \*/
+
+  //! Incremental sweep-and-prune broadphase class container
+  /**
+   * The box endpoints are kept sorted along every axis. Between two steps
+   * the boxes move only slightly, so the endpoint lists are nearly sorted and
+   * the insertion sort updates them in almost linear time. Every swap of a
+   * minimum and a maximum endpoint is a change of the overlap of two boxes
+   * along an axis, so only the pairs whose overlap status changed are
+   * checked and reported.
+  */
+  class sweepAndPrune
+  {
+  public:
+    typedef std::shared_ptr<sweepAndPrune> ptr;               //!< Shared pointer to sweep-and-prune object
+    typedef std::vector<std::pair<integer, integer>> vecpair; //!< Vector of pairs of box indices
+
+    //! Box endpoint along an axis
+    struct endpoint
+    {
+      real value; //!< Endpoint coordinate
+      integer id; //!< Twice the box index, plus one for the maximum endpoint
+    };
+
+  private:
+    std::vector<endpoint> m_endpoints[3]; //!< Sorted box endpoints along every axis
+    aabb::vecptr m_boxes;                 //!< Boxes of the last step
+    std::vector<real> m_bounds;           //!< Minimum and maximum points of the boxes of the last step
+    std::vector<real> m_previous;         //!< Minimum and maximum points of the boxes of the previous step
+    std::unordered_set<uint64_t> m_pairs; //!< Keys of the overlapping pairs of boxes
+
+    sweepAndPrune(sweepAndPrune const &sap);
+
+  public:
+    //! Sweep-and-prune class destructor
+    ~sweepAndPrune();
+
+    //! Sweep-and-prune class constructor
+    sweepAndPrune();
+
+    //! Clear sweep-and-prune data
+    void
+    clear(void);
+
+    //! Check if sweep-and-prune is empty
+    bool
+    isEmpty(void) const;
+
+    //! Get number of boxes
+    integer
+    size(void) const;
+
+    //! Build sweep-and-prune given a list of boxes
+    void
+    build(
+        aabb::vecptr const &boxes //!< List of boxes
+    );
+
+    //! Update sweep-and-prune with the moved boxes and report the changed pairs
+    void
+    update(
+        aabb::vecptr const &boxes, //!< List of moved boxes in the same order used to build
+        vecpair &added,            //!< Pairs of box indices that started overlapping
+        vecpair &removed           //!< Pairs of box indices that stopped overlapping
+    );
+
+    //! Get all the pairs of overlapping boxes (sorted by box indices)
+    void
+    pairs(
+        vecpair &pairs_out //!< Pairs of box indices
+    ) const;
+
+  private:
+    //! Copy the minimum and maximum points of the boxes
+    void
+    bounds(
+        aabb::vecptr const &boxes //!< List of boxes
+    );
+
+    //! Check if two boxes overlap given the minimum and maximum points of the boxes
+    static bool
+    overlaps(
+        std::vector<real> const &bounds, //!< Minimum and maximum points of the boxes
+        integer i,                       //!< Box index 0
+        integer j                        //!< Box index 1
+    )
+    {
+      real const *bounds_i = &bounds[6 * i];
+      real const *bounds_j = &bounds[6 * j];
+      return bounds_i[0] <= bounds_j[3] && bounds_i[3] >= bounds_j[0] &&
+             bounds_i[1] <= bounds_j[4] && bounds_i[4] >= bounds_j[1] &&
+             bounds_i[2] <= bounds_j[5] && bounds_i[5] >= bounds_j[2];
+    }
+
+    //! Sort the endpoints along an axis and update the pairs
+    void
+    sort(
+        size_t axis,     //!< Axis index
+        vecpair &added,  //!< Pairs of box indices that started overlapping
+        vecpair &removed //!< Pairs of box indices that stopped overlapping
+    );
+
+    //! Check if an endpoint comes before another one (minimum first on ties)
+    static bool
+    less(
+        endpoint const &endpoint0, //!< Input endpoint 0
+        endpoint const &endpoint1  //!< Input endpoint 1
+    )
+    {
+      return endpoint0.value < endpoint1.value ||
+             (endpoint0.value == endpoint1.value && (endpoint0.id & 1) < (endpoint1.id & 1));
+    }
+
+    //! Key of a pair of boxes
+    static uint64_t
+    key(
+        integer i, //!< Box index 0
+        integer j  //!< Box index 1
+    )
+    {
+      return uint64_t(std::min(i, j)) << 32 | uint64_t(std::max(i, j));
+    }
+
+  }; // class sweepAndPrune
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_sweepAndPrune.hh
+///
@@ -0,0 +1,224 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_wideAABBtree.hh
+///
+
+#ifndef INCLUDE_ACME_WIDEAABBTREE
+#define INCLUDE_ACME_WIDEAABBTREE
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_ray.hh"
+
+namespace acme
+{
+
+  /*\
+   |            _     _         _        _    ____  ____  _                 
+   |  __      _(_) __| | ___   / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |  \ \ /\ / / |/ _` |/ _ \ / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |   \ V  V /| | (_| |  __// ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |    \_/\_/ |_|\__,_|\___/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |                                                                        
+  \*/
+
+  //! Wide axis-aligned bouding box tree class container
+  /**
+   * Static 4-ary axis-aligned bouding box tree obtained by collapsing a binary
+   * AABB tree. Each node stores the boxes of its four children in SoA layout,
+   * so that a query box or ray is tested against all the children at once
+   * with SIMD instructions (AVX if enabled at compile time, SSE2 otherwise).
+  */
+  class wideAABBtree
+  {
+  public:
+    typedef std::shared_ptr<wideAABBtree> ptr; //!< Shared pointer to wide AABB tree object
+
+    static integer const WIDTH = 4; //!< Number of children of a node
+
+    //! Wide AABB tree node
+    struct node
+    {
+      real min_x[WIDTH];    //!< Children box minimum x values
+      real min_y[WIDTH];    //!< Children box minimum y values
+      real min_z[WIDTH];    //!< Children box minimum z values
+      real max_x[WIDTH];    //!< Children box maximum x values
+      real max_y[WIDTH];    //!< Children box maximum y values
+      real max_z[WIDTH];    //!< Children box maximum z values
+      integer child[WIDTH]; //!< Child node index (inner child) or first box index (leaf child)
+      integer count[WIDTH]; //!< Number of boxes of the leaf child (zero for inner children)
+      integer mask;         //!< Bit mask of the used children
+    };
+
+    typedef std::vector<node> vecnode; //!< Vector of wide AABB tree nodes
+
+  private:
+    static integer const STACK_SIZE = 64; //!< Size of the local stack of the traversal kernels
+
+    vecnode m_nodes;      //!< Tree nodes (root first)
+    aabb::vecptr m_boxes; //!< Tree boxes sorted by leaf
+
+    wideAABBtree(wideAABBtree const &tree);
+
+  public:
+    //! Wide AABB tree class destructor
+    ~wideAABBtree();
+
+    //! Wide AABB tree class constructor
+    wideAABBtree();
+
+    //! Clear wide AABB tree data
+    void
+    clear(void);
+
+    //! Check if wide AABB tree is empty
+    bool
+    isEmpty(void) const;
+
+    //! Build wide AABB tree by collapsing a binary AABB tree
+    void
+    build(
+        AABBtree const &tree //!< Input binary AABB tree
+    );
+
+    //! Build wide AABB tree given a list of boxes
+    void
+    build(
+        aabb::vecptr const &boxes,                 //!< List of boxes
+        AABBtree::method type = AABBtree::MIDPOINT //!< Building method of the binary tree
+    );
+
+    //! Get wide AABB tree depth
+    integer
+    depth(void) const;
+
+    //! Get wide AABB tree nodes const reference
+    vecnode const &
+    nodes(void) const;
+
+    //! Get wide AABB tree boxes (sorted by leaf) const reference
+    aabb::vecptr const &
+    boxes(void) const;
+
+    //! Compute all the tree boxes that overlap an external box
+    void
+    intersection(
+        aabb const &box,            //!< Input box
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Compute all the tree boxes hit by a ray
+    void
+    intersection(
+        ray const &ray_in,          //!< Input ray
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Compute all the intersection candidates of wide AABB trees
+    void
+    intersection(
+        wideAABBtree const &tree,          //!< Wide AABB tree used to check collision
+        aabb::vecpairptr &intersectionList //!< List of pair aabb that overlaps
+    ) const;
+
+  private:
+    //! Collapse the subtree of a binary AABB tree rooted at an inner node and return the new node index
+    integer
+    collapse(
+        AABBtree::vecnode const &nodes, //!< Binary AABB tree nodes
+        integer i                       //!< Binary AABB tree inner node index
+    );
+
+    //! Depth of the subtree rooted at a node
+    integer
+    depth(
+        integer i //!< Node index
+    ) const;
+
+    //! Compute all the boxes of the subtree rooted at a node that overlap a query box
+    void
+    boxIntersection(
+        real const min[3],          //!< Query box minimum point
+        real const max[3],          //!< Query box maximum point
+        integer i,                  //!< Node index
+        aabb::vecptr &candidateList //!< Output candidate list
+    ) const;
+
+    //! Compute all the boxes of the subtree rooted at a node hit by a ray
+    void
+    rayIntersection(
+        real const origin[3],        //!< Ray origin
+        real const inv_direction[3], //!< Inverse of the ray direction components
+        integer i,                   //!< Node index
+        aabb::vecptr &candidateList  //!< Output candidate list
+    ) const;
+
+    //! Compute all the intersection candidates of the subtrees rooted at two nodes
+    void
+    intersection(
+        wideAABBtree const &tree,          //!< Wide AABB tree used to check collision
+        integer i,                         //!< Node index in this tree
+        integer j,                         //!< Node index in the input tree
+        aabb::vecpairptr &intersectionList //!< List of pair aabb that overlaps
+    ) const;
+
+    //! Bit mask of the children of a node that overlap a box
+    static integer
+    overlapMask(
+        node const &node_in, //!< Input node
+        real const min[3],   //!< Box minimum point
+        real const max[3]    //!< Box maximum point
+    );
+
+    //! Bit mask of the children of a node hit by a ray
+    static integer
+    rayMask(
+        node const &node_in,        //!< Input node
+        real const origin[3],       //!< Ray origin
+        real const inv_direction[3] //!< Inverse of the ray direction components
+    );
+
+    //! Check if a box of a leaf is hit by a ray
+    static bool
+    rayHit(
+        aabb const &box_in,         //!< Input box
+        real const origin[3],       //!< Ray origin
+        real const inv_direction[3] //!< Inverse of the ray direction components
+    );
+
+  }; // class wideAABBtree
+
+} // namespace acme
+
+#endif
+
+///
+/// eof: acme_wideAABBtree.hh
+///
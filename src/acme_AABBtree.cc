@@ -41,9 +41,46 @@
 
 #include "acme_AABBtree.hh"
 
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ACME_AABBTREE_MMAP
+#endif
+
 namespace acme
 {
 
+  static size_t const PARALLEL_BUILD_SIZE = 16384; //!< Minimum number of boxes to build an AABB tree in parallel
+  static integer const PARALLEL_TASK_SIZE = 1024;  //!< Minimum number of boxes to build an AABB subtree in a separate task
+  static size_t const PARALLEL_QUERY_SIZE = 4096;  //!< Minimum number of nodes to traverse AABB trees in parallel
+  static size_t const PARALLEL_FRONTIER = 256;     //!< Number of node pairs shared among the threads in a parallel traversal
+
+  static char const FILE_MAGIC[8] = {'A', 'C', 'M', 'E', 'A', 'A', 'B', 'B'}; //!< Binary AABB tree file signature
+
+  //! Binary AABB tree file header, followed by the nodes and the input position of the leaf boxes
+  struct fileHeader
+  {
+    char magic[8];      //!< File signature
+    uint32_t version;   //!< File format version
+    uint32_t node_size; //!< Size of a node in bytes
+    int32_t method;     //!< Building method
+    int32_t leaf_size;  //!< Maximum number of boxes in a leaf
+    uint64_t nodes;     //!< Number of nodes
+    uint64_t boxes;     //!< Number of boxes
+    uint64_t checksum;  //!< Checksum of the boxes
+    double cost_build;  //!< Surface area heuristic cost of the tree after the build
+  };
+
   /*\
    |      _        _    ____  ____  _                 
    |     / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
@@ -55,18 +92,43 @@ namespace acme
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  // Node with the box of a leaf box, used to test the boxes of multi-box leaves
+  static inline AABBtree::node
+  boxNode(
+      aabb const &box)
+  {
+    AABBtree::node node_out;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      node_out.min[k] = box.min(k);
+      node_out.max[k] = box.max(k);
+    }
+    node_out.index = 0;
+    node_out.count = 1;
+    return node_out;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
   AABBtree::~AABBtree()
   {
-    this->m_ptrbox.reset();
-    this->m_children.clear();
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+    this->m_indices.clear();
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   AABBtree::AABBtree()
+      : m_method(AABBtree::MIDPOINT),
+        m_bins(16),
+        m_cost_traversal(1.0),
+        m_cost_intersection(1.0),
+        m_cost_build(0.0),
+        m_leaf_size(1),
+        m_counting(false)
   {
-    this->m_ptrbox.reset();
-    this->m_children.clear();
+    this->resetCounters();
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -74,8 +136,9 @@ namespace acme
   void
   AABBtree::clear()
   {
-    this->m_ptrbox.reset();
-    this->m_children.clear();
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+    this->m_indices.clear();
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -83,7 +146,55 @@ namespace acme
   bool
   AABBtree::isEmpty() const
   {
-    return this->m_children.empty() && !this->m_ptrbox;
+    return this->m_nodes.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::setMethod(
+      AABBtree::method type,
+      integer bins,
+      real cost_traversal,
+      real cost_intersection)
+  {
+    ACME_ASSERT(bins > 1,
+                "acme::AABBtree::setMethod(): at least two bins are required.")
+    ACME_ASSERT(cost_traversal >= 0.0 && cost_intersection > 0.0,
+                "acme::AABBtree::setMethod(): invalid surface area heuristic cost model.")
+    this->m_method = type;
+    this->m_bins = bins;
+    this->m_cost_traversal = cost_traversal;
+    this->m_cost_intersection = cost_intersection;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree::method
+  AABBtree::getMethod(void)
+      const
+  {
+    return this->m_method;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::setLeafSize(
+      integer leaf_size)
+  {
+    ACME_ASSERT(leaf_size > 0,
+                "acme::AABBtree::setLeafSize(): at least one box per leaf is required.")
+    this->m_leaf_size = leaf_size;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  AABBtree::getLeafSize(void)
+      const
+  {
+    return this->m_leaf_size;
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -97,215 +208,582 @@ namespace acme
     if (boxes.empty())
       return;
 
+    // A subtree of n boxes is stored in 2n-1 consecutive nodes, so the index of
+    // every node only depends on its range of boxes and not on the build order.
+    // The builders permute the box indices, the boxes are sorted at the end.
     integer size = boxes.size();
+    this->m_boxes = boxes;
+    this->m_indices.resize(size);
+    for (integer b = 0; b < size; ++b)
+      this->m_indices[b] = b;
+    this->m_nodes.resize(2 * size - 1);
 
-    if (size == 1)
+    if (this->m_method == AABBtree::LBVH)
     {
-      this->m_ptrbox = boxes.front();
-      return;
+      this->buildLBVH();
+    }
+    else
+    {
+#ifdef _OPENMP
+#pragma omp parallel if (boxes.size() > PARALLEL_BUILD_SIZE)
+#pragma omp single
+#endif
+      this->build(0, size, 0);
     }
 
-    this->m_ptrbox = std::make_shared<aabb const>(boxes, 0, 0);
+    if (this->m_leaf_size > 1)
+      this->compact();
 
-    real xmin = this->m_ptrbox->min(0);
-    real ymin = this->m_ptrbox->min(1);
-    real zmin = this->m_ptrbox->min(2);
-    real xmax = this->m_ptrbox->max(0);
-    real ymax = this->m_ptrbox->max(1);
-    real zmax = this->m_ptrbox->max(2);
+    for (integer b = 0; b < size; ++b)
+      this->m_boxes[b] = boxes[this->m_indices[b]];
+    this->m_cost_build = this->costSAH();
+  }
 
-    aabb::vecptr pos_boxes;
-    aabb::vecptr neg_boxes;
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-    if ((xmax - xmin) > (ymax - ymin) && (xmax - xmin) > (zmax - zmin))
+  void
+  AABBtree::build(
+      integer first,
+      integer last,
+      integer i)
+  {
+    // Compute the node box
+    node &parent = this->m_nodes[i];
+    aabb const &front = *this->m_boxes[this->m_indices[first]];
+    for (size_t k = 0; k < 3; ++k)
     {
-      real cut_pos = (xmax + xmin) / 2;
-      aabb::vecptr::const_iterator it;
-      for (it = boxes.begin(); it != boxes.end(); ++it)
-      {
-        real xmid = ((*it)->min(0) + (*it)->max(0)) / 2;
-        if (xmid > cut_pos)
-          pos_boxes.push_back(*it);
-        else
-          neg_boxes.push_back(*it);
-      }
+      parent.min[k] = front.min(k);
+      parent.max[k] = front.max(k);
     }
-    else if ((ymax - ymin) > (xmax - xmin) && (ymax - ymin) > (zmax - zmin))
+    for (integer b = first + 1; b < last; ++b)
     {
-      real cut_pos = (ymax + ymin) / 2;
-      aabb::vecptr::const_iterator it;
-      for (it = boxes.begin(); it != boxes.end(); ++it)
+      aabb const &box = *this->m_boxes[this->m_indices[b]];
+      for (size_t k = 0; k < 3; ++k)
       {
-        real ymid = ((*it)->min(1) + (*it)->max(1)) / 2;
-        if (ymid > cut_pos)
-          pos_boxes.push_back(*it);
-        else
-          neg_boxes.push_back(*it);
+        parent.min[k] = std::min(parent.min[k], box.min(k));
+        parent.max[k] = std::max(parent.max[k], box.max(k));
       }
     }
-    else
+
+    // The surface area heuristic keeps a range of at most the leaf size boxes
+    // as a leaf only if intersecting all its boxes is cheaper than the split
+    integer count = last - first;
+    bool leaf = count == 1 || (this->m_method != AABBtree::SAH && count <= this->m_leaf_size);
+    integer mid = first;
+    if (!leaf && this->m_method == AABBtree::SAH)
     {
-      real cut_pos = (zmax + zmin) / 2;
-      aabb::vecptr::const_iterator it;
-      for (it = boxes.begin(); it != boxes.end(); ++it)
-      {
-        real zmid = ((*it)->min(1) + (*it)->max(1)) / 2;
-        if (zmid > cut_pos)
-          pos_boxes.push_back(*it);
-        else
-          neg_boxes.push_back(*it);
-      }
+      real cost;
+      mid = this->splitSAH(parent, first, last, cost);
+      leaf = count <= this->m_leaf_size && this->m_cost_intersection * count <= cost;
     }
-
-    if (neg_boxes.empty())
+    else if (!leaf)
     {
-      aabb::vecptr::iterator mid_idx;
-      mid_idx = pos_boxes.begin() + pos_boxes.size() / 2;
-      neg_boxes.insert(neg_boxes.end(), mid_idx, pos_boxes.end());
-      pos_boxes.erase(mid_idx, pos_boxes.end());
+      mid = this->splitMidpoint(parent, first, last);
     }
-    else if (pos_boxes.empty())
+
+    if (leaf)
     {
-      aabb::vecptr::iterator mid_idx;
-      mid_idx = neg_boxes.begin() + neg_boxes.size() / 2;
-      pos_boxes.insert(pos_boxes.end(), mid_idx, neg_boxes.end());
-      neg_boxes.erase(mid_idx, neg_boxes.end());
+      parent.index = first;
+      parent.count = count;
+      return;
     }
 
-    AABBtree::ptr neg = std::make_shared<AABBtree>();
-    AABBtree::ptr pos = std::make_shared<AABBtree>();
+    // Split in two halves if all the boxes lay on the same side of the cut
+    if (mid == first || mid == last)
+      mid = first + (last - first) / 2;
 
-    neg->build(neg_boxes);
-    if (!neg->isEmpty())
-      this->m_children.push_back(neg);
+    integer right = i + 2 * (mid - first);
+    parent.index = right;
+    parent.count = 0;
 
-    pos->build(pos_boxes);
-    if (!pos->isEmpty())
-      this->m_children.push_back(pos);
+#ifdef _OPENMP
+#pragma omp task if (mid - first > PARALLEL_TASK_SIZE)
+#endif
+    this->build(first, mid, i + 1);
+    this->build(mid, last, right);
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   void
-  AABBtree::print(
-      out_stream &os,
-      integer level)
-      const
+  AABBtree::compact(void)
   {
-    if (this->isEmpty())
+    // A leaf of n boxes is stored in the first of the 2n-1 nodes reserved for
+    // its range, so the unused nodes are skipped at once and the depth-first
+    // order is kept
+    integer size = this->m_nodes.size();
+    integer used = 0;
+    for (integer i = 0; i < size; ++used)
+      i += this->m_nodes[i].count > 0 ? 2 * this->m_nodes[i].count - 1 : 1;
+
+    vecnode nodes;
+    nodes.reserve(used);
+    std::vector<integer> map(size, -1);
+    for (integer i = 0; i < size;)
     {
-      os << "[EMPTY AABB tree]" << std::endl;
+      map[i] = nodes.size();
+      nodes.push_back(this->m_nodes[i]);
+      i += this->m_nodes[i].count > 0 ? 2 * this->m_nodes[i].count - 1 : 1;
     }
-    else
+    for (vecnode::iterator it = nodes.begin(); it != nodes.end(); ++it)
+      if (it->count == 0)
+        it->index = map[it->index];
+    this->m_nodes.swap(nodes);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Spread the lower 21 bits of a value over every third bit
+  static uint64_t
+  mortonExpand(
+      uint64_t value)
+  {
+    value &= 0x1FFFFF;
+    value = (value | value << 32) & 0x1F00000000FFFF;
+    value = (value | value << 16) & 0x1F0000FF0000FF;
+    value = (value | value << 8) & 0x100F00F00F00F00F;
+    value = (value | value << 4) & 0x10C30C30C30C30C3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Number of leading zero bits of a 64-bit value
+  static integer
+  leadingZeros(
+      uint64_t value)
+  {
+    if (value == 0)
+      return 64;
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    integer count = 0;
+    while (!(value & (uint64_t(1) << 63)))
+    {
+      value <<= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Stable LSD radix sort of (code, index) pairs on 8-bit digits, the digit
+  // histograms and the scattering are split among the OpenMP threads
+  static void
+  radixSort(
+      std::vector<uint64_t> &codes,
+      std::vector<integer> &indices)
+  {
+    size_t size = codes.size();
+    std::vector<uint64_t> codes_tmp(size);
+    std::vector<integer> indices_tmp(size);
+    std::vector<size_t> histogram;
+
+    for (integer shift = 0; shift < 64; shift += 8)
     {
-      os << std::scientific
-         << std::showpoint
-         << std::setprecision(10)
-         << "Box =" << std::endl
-         << "Minimum = [ " << this->m_ptrbox->min(0) << ", " << this->m_ptrbox->min(1) << ", " << this->m_ptrbox->min(2) << " ]'" << std::endl
-         << "Maximum = [ " << this->m_ptrbox->max(0) << ", " << this->m_ptrbox->max(1) << ", " << this->m_ptrbox->max(2) << " ]'" << std::endl
-         << std::endl;
-      AABBtree::vecptr::const_iterator it;
-      for (it = this->m_children.begin(); it != this->m_children.end(); ++it)
-        (*it)->print(os, level + 1);
+      integer threads = 1;
+#ifdef _OPENMP
+      if (size > PARALLEL_BUILD_SIZE)
+        threads = omp_get_max_threads();
+#endif
+      histogram.assign(256 * threads, 0);
+
+      // Per-thread digit histograms
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+      {
+        integer t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        size_t chunk_first = size * t / threads;
+        size_t chunk_last = size * (t + 1) / threads;
+        size_t *chunk_histogram = &histogram[256 * t];
+        for (size_t k = chunk_first; k < chunk_last; ++k)
+          ++chunk_histogram[(codes[k] >> shift) & 0xFF];
+      }
+
+      // Skip the digit if all the codes share it
+      bool skip = false;
+      for (size_t d = 0; d < 256 && !skip; ++d)
+      {
+        size_t count = 0;
+        for (integer t = 0; t < threads; ++t)
+          count += histogram[256 * t + d];
+        skip = count == size;
+      }
+      if (skip)
+        continue;
+
+      // Scatter offsets ordered by digit and thread
+      size_t offset = 0;
+      for (size_t d = 0; d < 256; ++d)
+      {
+        for (integer t = 0; t < threads; ++t)
+        {
+          size_t count = histogram[256 * t + d];
+          histogram[256 * t + d] = offset;
+          offset += count;
+        }
+      }
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (threads > 1)
+#endif
+      {
+        integer t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        size_t chunk_first = size * t / threads;
+        size_t chunk_last = size * (t + 1) / threads;
+        size_t *chunk_offset = &histogram[256 * t];
+        for (size_t k = chunk_first; k < chunk_last; ++k)
+        {
+          size_t pos = chunk_offset[(codes[k] >> shift) & 0xFF]++;
+          codes_tmp[pos] = codes[k];
+          indices_tmp[pos] = indices[k];
+        }
+      }
+      codes.swap(codes_tmp);
+      indices.swap(indices_tmp);
     }
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   void
-  AABBtree::intersection(
-      AABBtree const &tree,
-      aabb::vecpairptr &intersection_list,
-      bool swap_tree)
-      const
+  AABBtree::buildLBVH(void)
   {
-    // Check aabb with
-    if (!tree.m_ptrbox->intersects(*this->m_ptrbox))
+    integer size = this->m_boxes.size();
+
+    // Bounds of the box centroids
+    point cmin(this->m_boxes.front()->min() + this->m_boxes.front()->max());
+    point cmax(cmin);
+    aabb::vecptr::const_iterator it;
+    for (it = this->m_boxes.begin(); it != this->m_boxes.end(); ++it)
+    {
+      point center((*it)->min() + (*it)->max());
+      cmin = cmin.cwiseMin(center);
+      cmax = cmax.cwiseMax(center);
+    }
+
+    // Morton codes of the box centroids quantized on 21 bits per axis
+    real scale[3];
+    for (size_t k = 0; k < 3; ++k)
+      scale[k] = cmax[k] > cmin[k] ? real(0x1FFFFF) / (cmax[k] - cmin[k]) : 0.0;
+    std::vector<uint64_t> codes(size);
+    std::vector<integer> indices(size);
+#ifdef _OPENMP
+#pragma omp parallel for if (size > integer(PARALLEL_BUILD_SIZE))
+#endif
+    for (integer b = 0; b < size; ++b)
+    {
+      aabb const &box = *this->m_boxes[b];
+      uint64_t code = 0;
+      for (size_t k = 0; k < 3; ++k)
+      {
+        real center = box.min(k) + box.max(k);
+        code |= mortonExpand(uint64_t((center - cmin[k]) * scale[k])) << (2 - k);
+      }
+      codes[b] = code;
+      indices[b] = b;
+    }
+    radixSort(codes, indices);
+    this->m_indices.swap(indices);
+
+    if (size == 1)
+    {
+      this->build(0, 1, 0);
       return;
-    integer icase = (this->m_children.empty() ? 0 : 1) +
-                    (tree.m_children.empty() ? 0 : 2);
-    switch (icase)
+    }
+
+    // The split k separates the boxes k and k+1 and its level is the length of
+    // the common prefix of their codes (duplicate codes are told apart by the
+    // box index). The tree of the splits is the Cartesian tree of the levels,
+    // which is built in linear time with a stack.
+    integer splits = size - 1;
+    std::vector<integer> level(splits);
+    for (integer k = 0; k < splits; ++k)
     {
-    case 0: // Both are leafs
-      if (swap_tree)
-        intersection_list.push_back(aabb::pairptr(tree.m_ptrbox, this->m_ptrbox));
+      if (codes[k] == codes[k + 1])
+        level[k] = 64 + leadingZeros(uint64_t(k ^ (k + 1)));
       else
-        intersection_list.push_back(aabb::pairptr(this->m_ptrbox, tree.m_ptrbox));
-      break;
-    case 1: // First is a tree, second is a leaf
-    {
-      AABBtree::vecptr::const_iterator it;
-      for (it = this->m_children.begin(); it != this->m_children.end(); ++it)
-        tree.intersection(**it, intersection_list, !swap_tree);
+        level[k] = leadingZeros(codes[k] ^ codes[k + 1]);
     }
-    break;
-    case 2: // First leaf, second is a tree
+    std::vector<integer> left(splits, -1);
+    std::vector<integer> right(splits, -1);
+    std::vector<integer> stack;
+    stack.reserve(128);
+    for (integer k = 0; k < splits; ++k)
     {
-      AABBtree::vecptr::const_iterator it;
-      for (it = tree.m_children.begin(); it != tree.m_children.end(); ++it)
-        this->intersection(**it, intersection_list, swap_tree);
+      integer last = -1;
+      while (!stack.empty() && level[stack.back()] > level[k])
+      {
+        last = stack.back();
+        stack.pop_back();
+      }
+      left[k] = last;
+      if (!stack.empty())
+        right[stack.back()] = k;
+      stack.push_back(k);
     }
-    break;
-    case 3: // First is a tree, second is a tree
+
+#ifdef _OPENMP
+#pragma omp parallel if (size > integer(PARALLEL_BUILD_SIZE))
+#pragma omp single
+#endif
+    this->emitLBVH(left, right, stack.front(), 0, size, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::emitLBVH(
+      std::vector<integer> const &left,
+      std::vector<integer> const &right,
+      integer k,
+      integer first,
+      integer last,
+      integer i)
+  {
+    if (k < 0 || last - first <= this->m_leaf_size)
     {
-      AABBtree::vecptr::const_iterator c1;
-      AABBtree::vecptr::const_iterator c2;
-      for (c1 = this->m_children.begin(); c1 != this->m_children.end(); ++c1)
-        for (c2 = tree.m_children.begin(); c2 != tree.m_children.end(); ++c2)
-          (*c1)->intersection(**c2, intersection_list, swap_tree);
+      this->build(first, last, i);
+      return;
     }
-    break;
+
+    integer mid = k + 1;
+    integer right_node = i + 2 * (mid - first);
+
+#ifdef _OPENMP
+#pragma omp task shared(left, right) if (mid - first > PARALLEL_TASK_SIZE)
+#endif
+    this->emitLBVH(left, right, left[k], first, mid, i + 1);
+    this->emitLBVH(left, right, right[k], mid, last, right_node);
+#ifdef _OPENMP
+#pragma omp taskwait
+#endif
+
+    node &parent = this->m_nodes[i];
+    node const &node_l = this->m_nodes[i + 1];
+    node const &node_r = this->m_nodes[right_node];
+    for (size_t n = 0; n < 3; ++n)
+    {
+      parent.min[n] = std::min(node_l.min[n], node_r.min[n]);
+      parent.max[n] = std::max(node_l.max[n], node_r.max[n]);
     }
+    parent.index = right_node;
+    parent.count = 0;
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-  real
-  AABBtree::minimumExteriorDistance(
-      point const &query,
-      AABBtree const &tree,
-      real distance)
+  integer
+  AABBtree::splitMidpoint(
+      node const &parent,
+      integer first,
+      integer last)
+  {
+    real dx = parent.max[0] - parent.min[0];
+    real dy = parent.max[1] - parent.min[1];
+    real dz = parent.max[2] - parent.min[2];
+
+    size_t axis = 2;
+    if (dx > dy && dx > dz)
+      axis = 0;
+    else if (dy > dx && dy > dz)
+      axis = 1;
+
+    real cut_pos = (parent.max[axis] + parent.min[axis]) / 2;
+    aabb::vecptr const &boxes = this->m_boxes;
+    std::vector<integer>::iterator it = std::partition(
+        this->m_indices.begin() + first,
+        this->m_indices.begin() + last,
+        [&boxes, axis, cut_pos](integer b)
+        { return (boxes[b]->min(axis) + boxes[b]->max(axis)) / 2 <= cut_pos; });
+    return it - this->m_indices.begin();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  AABBtree::splitSAH(
+      node const &parent,
+      integer first,
+      integer last,
+      real &cost_out)
   {
-    AABBtree::vecptr const &tree_children = tree.m_children;
-    if (tree_children.empty())
+    aabb::vecptr const &boxes = this->m_boxes;
+    std::vector<integer>::iterator begin = this->m_indices.begin() + first;
+    std::vector<integer>::iterator end = this->m_indices.begin() + last;
+    std::vector<integer>::iterator it;
+
+    // Bounds of the box centroids
+    point cmin(boxes[*begin]->min() + boxes[*begin]->max());
+    point cmax(cmin);
+    for (it = begin; it != end; ++it)
+    {
+      point center(boxes[*it]->min() + boxes[*it]->max());
+      cmin = cmin.cwiseMin(center);
+      cmax = cmax.cwiseMax(center);
+    }
+    cmin /= 2;
+    cmax /= 2;
+
+    integer bins = this->m_bins;
+    std::vector<aabb> bin_box(bins);
+    std::vector<integer> bin_count(bins);
+    std::vector<real> neg_area(bins);
+    std::vector<integer> neg_count(bins);
+
+    // Cost of the split relative to the parent box, the children areas are
+    // the probabilities of traversing them given a hit on the parent
+    real parent_area = area(parent);
+    real cost_scale = parent_area > 0.0 ? this->m_cost_intersection / parent_area : 0.0;
+    real best_cost = INFTY;
+    size_t best_axis = 0;
+    integer best_cut = 0;
+    for (size_t axis = 0; axis < 3; ++axis)
     {
-      real dst = tree.m_ptrbox->exteriorDistance(query);
-      return std::min(dst, distance);
+      real extent = cmax[axis] - cmin[axis];
+      if (extent <= 0.0)
+        continue;
+      real scale = bins / extent;
+
+      // Fill the bins with the boxes
+      std::fill(bin_count.begin(), bin_count.end(), 0);
+      for (it = begin; it != end; ++it)
+      {
+        aabb const &box = *boxes[*it];
+        real mid = (box.min(axis) + box.max(axis)) / 2;
+        integer b = std::min(bins - 1, integer((mid - cmin[axis]) * scale));
+        if (bin_count[b] == 0)
+        {
+          bin_box[b].min() = box.min();
+          bin_box[b].max() = box.max();
+        }
+        else
+        {
+          bin_box[b].min() = bin_box[b].min().cwiseMin(box.min());
+          bin_box[b].max() = bin_box[b].max().cwiseMax(box.max());
+        }
+        ++bin_count[b];
+      }
+
+      // Sweep from the negative side and store the partial areas
+      aabb sweep;
+      integer count = 0;
+      for (integer b = 0; b < bins - 1; ++b)
+      {
+        if (bin_count[b] > 0)
+        {
+          if (count == 0)
+          {
+            sweep.min() = bin_box[b].min();
+            sweep.max() = bin_box[b].max();
+          }
+          else
+          {
+            sweep.min() = sweep.min().cwiseMin(bin_box[b].min());
+            sweep.max() = sweep.max().cwiseMax(bin_box[b].max());
+          }
+          count += bin_count[b];
+        }
+        neg_count[b] = count;
+        neg_area[b] = count > 0 ? sweep.area() : 0.0;
+      }
+
+      // Sweep from the positive side and evaluate the cut costs
+      count = 0;
+      for (integer b = bins - 1; b > 0; --b)
+      {
+        if (bin_count[b] > 0)
+        {
+          if (count == 0)
+          {
+            sweep.min() = bin_box[b].min();
+            sweep.max() = bin_box[b].max();
+          }
+          else
+          {
+            sweep.min() = sweep.min().cwiseMin(bin_box[b].min());
+            sweep.max() = sweep.max().cwiseMax(bin_box[b].max());
+          }
+          count += bin_count[b];
+        }
+        if (count == 0 || neg_count[b - 1] == 0)
+          continue;
+        real cost = this->m_cost_traversal +
+                    cost_scale * (neg_area[b - 1] * neg_count[b - 1] + sweep.area() * count);
+        if (cost < best_cost)
+        {
+          best_cost = cost;
+          best_axis = axis;
+          best_cut = b;
+        }
+      }
     }
-    real dmin = tree.m_ptrbox->centerDistance(query);
-    if (dmin > distance)
-      return distance;
-    // check aabb with
-    AABBtree::vecptr::const_iterator it;
-    for (it = tree_children.begin(); it != tree_children.end(); ++it)
-      distance = minimumExteriorDistance(query, **it, distance);
-    return distance;
+
+    // All the centroids are coincident, leave the split to the caller
+    cost_out = best_cost;
+    if (best_cost == INFTY)
+      return first;
+
+    real cmin_axis = cmin[best_axis];
+    real scale = bins / (cmax[best_axis] - cmin_axis);
+    it = std::partition(
+        begin, end,
+        [&boxes, best_axis, best_cut, bins, cmin_axis, scale](integer b)
+        {
+          real mid = (boxes[b]->min(best_axis) + boxes[b]->max(best_axis)) / 2;
+          return std::min(bins - 1, integer((mid - cmin_axis) * scale)) < best_cut;
+        });
+    return it - this->m_indices.begin();
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   void
-  AABBtree::selectLessThanDistance(
-      point const &query,
-      real distance,
-      AABBtree const &tree,
-      aabb::vecptr &candidate_list)
+  AABBtree::refit(void)
   {
-    AABBtree::vecptr const &tree_children = tree.m_children;
-    real dst = tree.m_ptrbox->centerDistance(query);
-    if (dst <= distance)
+    // Children are always stored after their parent
+    vecnode::reverse_iterator it;
+    for (it = this->m_nodes.rbegin(); it != this->m_nodes.rend(); ++it)
     {
-      if (tree_children.empty())
+      node &node_i = *it;
+      if (node_i.count > 0)
       {
-        candidate_list.push_back(tree.m_ptrbox);
+        aabb const &front = *this->m_boxes[node_i.index];
+        for (size_t k = 0; k < 3; ++k)
+        {
+          node_i.min[k] = front.min(k);
+          node_i.max[k] = front.max(k);
+        }
+        for (integer b = node_i.index + 1; b < node_i.index + node_i.count; ++b)
+        {
+          aabb const &box = *this->m_boxes[b];
+          for (size_t k = 0; k < 3; ++k)
+          {
+            node_i.min[k] = std::min(node_i.min[k], box.min(k));
+            node_i.max[k] = std::max(node_i.max[k], box.max(k));
+          }
+        }
       }
       else
       {
-        // Check aabb with
-        AABBtree::vecptr::const_iterator it;
-        for (it = tree_children.begin(); it != tree_children.end(); ++it)
-          selectLessThanDistance(query, distance, **it, candidate_list);
+        node const &node_l = *(it - 1);
+        node const &node_r = this->m_nodes[node_i.index];
+        for (size_t k = 0; k < 3; ++k)
+        {
+          node_i.min[k] = std::min(node_l.min[k], node_r.min[k]);
+          node_i.max[k] = std::max(node_l.max[k], node_r.max[k]);
+        }
       }
     }
   }
@@ -313,13 +791,1103 @@ namespace acme
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   void
-  AABBtree::selectMinimumDistance(
-      point const &query,
-      aabb::vecptr &candidate_list)
+  AABBtree::refit(
+      aabb::vecptr const &boxes)
+  {
+    ACME_ASSERT(boxes.size() == this->m_boxes.size(),
+                "acme::AABBtree::refit(): the number of boxes does not match the tree.")
+    for (size_t b = 0; b < boxes.size(); ++b)
+      this->m_boxes[b] = boxes[this->m_indices[b]];
+    this->refit();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  AABBtree::degradation(void)
+      const
+  {
+    if (this->isEmpty() || this->m_cost_build <= 0.0)
+      return 1.0;
+    return this->costSAH() / this->m_cost_build;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree::vecnode const &
+  AABBtree::nodes(void)
+      const
+  {
+    return this->m_nodes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::vecptr const &
+  AABBtree::boxes(void)
+      const
+  {
+    return this->m_boxes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  AABBtree::costSAH(void)
+      const
+  {
+    if (this->isEmpty())
+      return 0.0;
+    real cost = 0.0;
+    vecnode::const_iterator it;
+    for (it = this->m_nodes.begin(); it != this->m_nodes.end(); ++it)
+    {
+      if (it->count > 0)
+        cost += this->m_cost_intersection * it->count * area(*it);
+      else
+        cost += this->m_cost_traversal * area(*it);
+    }
+    real root_area = area(this->m_nodes.front());
+    return root_area > 0.0 ? cost / root_area : cost;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree::statistics
+  AABBtree::getStatistics(void)
+      const
+  {
+    statistics stats;
+    stats.nodes = this->m_nodes.size();
+    stats.leaves = 0;
+    stats.depth = 0;
+    stats.mean_depth = 0.0;
+    stats.occupancy = 0.0;
+    stats.cost = this->costSAH();
+    stats.overlap = 0.0;
+    if (this->isEmpty())
+      return stats;
+
+    // Children are always stored after their parent
+    std::vector<integer> depth(this->m_nodes.size(), 0);
+    for (size_t i = 0; i < this->m_nodes.size(); ++i)
+    {
+      node const &node_i = this->m_nodes[i];
+      if (node_i.count > 0)
+      {
+        if (stats.depth_histogram.size() <= size_t(depth[i]))
+          stats.depth_histogram.resize(depth[i] + 1, 0);
+        if (stats.leaf_histogram.size() <= size_t(node_i.count))
+          stats.leaf_histogram.resize(node_i.count + 1, 0);
+        ++stats.depth_histogram[depth[i]];
+        ++stats.leaf_histogram[node_i.count];
+        ++stats.leaves;
+        stats.depth = std::max(stats.depth, depth[i]);
+        stats.mean_depth += depth[i];
+        continue;
+      }
+      depth[i + 1] = depth[i] + 1;
+      depth[node_i.index] = depth[i] + 1;
+      node const &node_l = this->m_nodes[i + 1];
+      node const &node_r = this->m_nodes[node_i.index];
+      real volume = 1.0;
+      for (size_t k = 0; k < 3; ++k)
+        volume *= std::max(0.0, std::min(node_l.max[k], node_r.max[k]) - std::max(node_l.min[k], node_r.min[k]));
+      stats.overlap += volume;
+    }
+    stats.mean_depth /= stats.leaves;
+    stats.occupancy = real(this->m_boxes.size()) / stats.leaves;
+    return stats;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::setCounting(
+      bool counting)
+  {
+    this->m_counting = counting;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::resetCounters(void)
+  {
+    this->m_counters.nodes = 0;
+    this->m_counters.boxes = 0;
+    this->m_counters.items = 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree::counters const &
+  AABBtree::getCounters(void)
+      const
+  {
+    return this->m_counters;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::count(
+      size_t nodes,
+      size_t boxes,
+      size_t items)
+      const
+  {
+    if (!this->m_counting)
+      return;
+    // The kernels of the parallel queries run concurrently
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    this->m_counters.nodes += nodes;
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    this->m_counters.boxes += boxes;
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    this->m_counters.items += items;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  uint64_t
+  AABBtree::checksum(
+      aabb::vecptr const &boxes)
+  {
+    // 64-bit FNV-1a hash of the box coordinates in the input order
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t b = 0; b < boxes.size(); ++b)
+    {
+      real coordinates[6] = {boxes[b]->min(0), boxes[b]->min(1), boxes[b]->min(2),
+                             boxes[b]->max(0), boxes[b]->max(1), boxes[b]->max(2)};
+      unsigned char const *bytes = reinterpret_cast<unsigned char const *>(coordinates);
+      for (size_t k = 0; k < sizeof(coordinates); ++k)
+      {
+        hash ^= bytes[k];
+        hash *= 1099511628211ULL;
+      }
+    }
+    return hash;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  AABBtree::save(
+      std::string const &filename)
+      const
+  {
+    // Restore the input order of the boxes to compute the checksum
+    aabb::vecptr boxes(this->m_boxes.size());
+    for (size_t b = 0; b < this->m_boxes.size(); ++b)
+      boxes[this->m_indices[b]] = this->m_boxes[b];
+
+    fileHeader header;
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.node_size = sizeof(node);
+    header.method = this->m_method;
+    header.leaf_size = this->m_leaf_size;
+    header.nodes = this->m_nodes.size();
+    header.boxes = this->m_boxes.size();
+    header.checksum = checksum(boxes);
+    header.cost_build = this->m_cost_build;
+
+    std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+      return false;
+    file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const *>(this->m_nodes.data()), this->m_nodes.size() * sizeof(node));
+    file.write(reinterpret_cast<char const *>(this->m_indices.data()), this->m_indices.size() * sizeof(integer));
+    return file.good();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  AABBtree::load(
+      std::string const &filename,
+      aabb::vecptr const &boxes)
+  {
+    clear();
+
+#ifdef ACME_AABBTREE_MMAP
+    int descriptor = open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+      return false;
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(fileHeader)))
+    {
+      close(descriptor);
+      return false;
+    }
+    size_t size = status.st_size;
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (data == MAP_FAILED)
+      return false;
+    bool loaded = this->load(static_cast<char const *>(data), size, boxes);
+    munmap(data, size);
+    return loaded;
+#else
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file)
+      return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return this->load(data.data(), data.size(), boxes);
+#endif
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  AABBtree::load(
+      char const *data,
+      size_t size,
+      aabb::vecptr const &boxes)
+  {
+    fileHeader header;
+    if (size < sizeof(header))
+      return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        header.version != FILE_VERSION ||
+        header.node_size != sizeof(node) ||
+        header.boxes != boxes.size() ||
+        (header.nodes == 0) != (header.boxes == 0) ||
+        header.nodes > 2 * header.boxes ||
+        header.method < MIDPOINT || header.method > LBVH ||
+        header.leaf_size < 1 ||
+        size != sizeof(header) + header.nodes * sizeof(node) + header.boxes * sizeof(integer) ||
+        header.checksum != checksum(boxes))
+      return false;
+
+    this->m_nodes.resize(header.nodes);
+    this->m_indices.resize(header.boxes);
+    data += sizeof(header);
+    std::memcpy(this->m_nodes.data(), data, header.nodes * sizeof(node));
+    data += header.nodes * sizeof(node);
+    std::memcpy(this->m_indices.data(), data, header.boxes * sizeof(integer));
+
+    // The children must follow their parent in the preorder, so that the
+    // traversals always end, and the leaves must lie in the box range
+    integer nodes = header.nodes;
+    integer size_boxes = header.boxes;
+    for (integer i = 0; i < nodes; ++i)
+    {
+      node const &node_i = this->m_nodes[i];
+      bool valid = node_i.count == 0
+                       ? i + 1 < nodes && node_i.index > i + 1 && node_i.index < nodes
+                       : node_i.count > 0 && node_i.index >= 0 && node_i.index <= size_boxes - node_i.count;
+      if (!valid)
+      {
+        clear();
+        return false;
+      }
+    }
+
+    // The input positions of the boxes must be a permutation
+    std::vector<bool> used(header.boxes, false);
+    this->m_boxes.resize(header.boxes);
+    for (size_t b = 0; b < header.boxes; ++b)
+    {
+      integer index = this->m_indices[b];
+      if (index < 0 || index >= size_boxes || used[index])
+      {
+        clear();
+        return false;
+      }
+      used[index] = true;
+      this->m_boxes[b] = boxes[index];
+    }
+    this->m_method = static_cast<AABBtree::method>(header.method);
+    this->m_leaf_size = header.leaf_size;
+    this->m_cost_build = header.cost_build;
+    return true;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::print(
+      out_stream &os,
+      integer level)
+      const
+  {
+    if (this->isEmpty())
+      os << "[EMPTY AABB tree]" << std::endl;
+    else
+      this->print(os, 0, level);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::print(
+      out_stream &os,
+      integer i,
+      integer level)
+      const
+  {
+    node const &node_i = this->m_nodes[i];
+    os << std::scientific
+       << std::showpoint
+       << std::setprecision(10)
+       << "Box =" << std::endl
+       << "Minimum = [ " << node_i.min[0] << ", " << node_i.min[1] << ", " << node_i.min[2] << " ]'" << std::endl
+       << "Maximum = [ " << node_i.max[0] << ", " << node_i.max[1] << ", " << node_i.max[2] << " ]'" << std::endl
+       << std::endl;
+    if (node_i.count == 0)
+    {
+      this->print(os, i + 1, level + 1);
+      this->print(os, node_i.index, level + 1);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      AABBtree const &tree,
+      aabb::vecpairptr &intersection_list,
+      bool swap_tree)
+      const
+  {
+    if (this->isEmpty() || tree.isEmpty())
+      return;
+    size_t size = intersection_list.size();
+    this->intersection(tree, 0, 0, intersection_list, swap_tree);
+    this->count(0, 0, intersection_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      AABBtree const &tree,
+      integer i,
+      integer j,
+      aabb::vecpairptr &intersection_list,
+      bool swap_tree)
+      const
+  {
+    // The children pairs are pushed in reverse order, so that the visiting
+    // order is the same as the depth-first recursion
+    integer stack_i[STACK_SIZE];
+    integer stack_j[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack_i[top] = i;
+    stack_j[top] = j;
+    ++top;
+    while (top > 0)
+    {
+      --top;
+      i = stack_i[top];
+      j = stack_j[top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      node const &node_j = tree.m_nodes[j];
+
+      // check aabb with
+      if (!intersects(node_i, node_j))
+        continue;
+
+      integer size = 0;
+      integer child_i[4];
+      integer child_j[4];
+      integer icase = (node_i.count > 0 ? 0 : 1) + (node_j.count > 0 ? 0 : 2);
+      switch (icase)
+      {
+      case 0: // Both are leafs
+        tested += node_i.count * node_j.count;
+        for (integer a = node_i.index; a < node_i.index + node_i.count; ++a)
+        {
+          for (integer b = node_j.index; b < node_j.index + node_j.count; ++b)
+          {
+            if (node_i.count + node_j.count > 2 && !this->m_boxes[a]->intersects(*tree.m_boxes[b]))
+              continue;
+            if (swap_tree)
+              intersection_list.push_back(aabb::pairptr(tree.m_boxes[b], this->m_boxes[a]));
+            else
+              intersection_list.push_back(aabb::pairptr(this->m_boxes[a], tree.m_boxes[b]));
+          }
+        }
+        break;
+      case 1: // First is a tree, second is a leaf
+        child_i[size] = node_i.index, child_j[size++] = j;
+        child_i[size] = i + 1, child_j[size++] = j;
+        break;
+      case 2: // First leaf, second is a tree
+        child_i[size] = i, child_j[size++] = node_j.index;
+        child_i[size] = i, child_j[size++] = j + 1;
+        break;
+      case 3: // First is a tree, second is a tree
+        child_i[size] = node_i.index, child_j[size++] = node_j.index;
+        child_i[size] = node_i.index, child_j[size++] = j + 1;
+        child_i[size] = i + 1, child_j[size++] = node_j.index;
+        child_i[size] = i + 1, child_j[size++] = j + 1;
+        break;
+      }
+
+      if (top + size > STACK_SIZE)
+      {
+        // The local stack is full, visit the children pairs on a new one
+        for (integer k = size - 1; k >= 0; --k)
+          this->intersection(tree, child_i[k], child_j[k], intersection_list, swap_tree);
+        continue;
+      }
+      for (integer k = 0; k < size; ++k, ++top)
+      {
+        stack_i[top] = child_i[k];
+        stack_j[top] = child_j[k];
+      }
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::relativeTransform(
+      affine const &transform,
+      relative &transform_out)
+  {
+    affine inverse(transform.inverse());
+    for (integer k = 0; k < 3; ++k)
+    {
+      for (integer l = 0; l < 3; ++l)
+      {
+        transform_out.linear[k][l] = transform.linear()(k, l);
+        transform_out.linear_abs[k][l] = std::abs(transform_out.linear[k][l]);
+        transform_out.inverse[k][l] = inverse.linear()(k, l);
+        transform_out.inverse_abs[k][l] = std::abs(transform_out.inverse[k][l]);
+      }
+      transform_out.translation[k] = transform.translation()(k);
+      transform_out.inverse_translation[k] = inverse.translation()(k);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      AABBtree const &tree,
+      affine const &transform,
+      aabb::vecpairptr &intersection_list,
+      bool swap_tree)
+      const
+  {
+    if (this->isEmpty() || tree.isEmpty())
+      return;
+    relative transform_in;
+    relativeTransform(transform, transform_in);
+    size_t size = intersection_list.size();
+    this->intersection(tree, transform_in, 0, 0, intersection_list, swap_tree);
+    this->count(0, 0, intersection_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      AABBtree const &tree,
+      relative const &transform_in,
+      integer i,
+      integer j,
+      aabb::vecpairptr &intersection_list,
+      bool swap_tree)
+      const
+  {
+    integer stack_i[STACK_SIZE];
+    integer stack_j[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack_i[top] = i;
+    stack_j[top] = j;
+    ++top;
+    while (top > 0)
+    {
+      --top;
+      i = stack_i[top];
+      j = stack_j[top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      node const &node_j = tree.m_nodes[j];
+      if (!intersects(node_i, node_j, transform_in))
+        continue;
+
+      // Both leafs, test the boxes of the leaves in the two frames
+      if (node_i.count > 0 && node_j.count > 0)
+      {
+        tested += node_i.count * node_j.count;
+        for (integer a = node_i.index; a < node_i.index + node_i.count; ++a)
+        {
+          for (integer b = node_j.index; b < node_j.index + node_j.count; ++b)
+          {
+            aabb const &box_a = *this->m_boxes[a];
+            aabb const &box_b = *tree.m_boxes[b];
+            if (node_i.count + node_j.count > 2 &&
+                !intersects(box_a.min().data(), box_a.max().data(), box_b.min().data(), box_b.max().data(), transform_in))
+              continue;
+            if (swap_tree)
+              intersection_list.push_back(aabb::pairptr(tree.m_boxes[b], this->m_boxes[a]));
+            else
+              intersection_list.push_back(aabb::pairptr(this->m_boxes[a], tree.m_boxes[b]));
+          }
+        }
+        continue;
+      }
+
+      // Split the larger node
+      integer first_i = i, first_j = j, second_i = i, second_j = j;
+      if (node_j.count > 0 || (node_i.count == 0 && area(node_i) >= area(node_j)))
+      {
+        first_i = i + 1;
+        second_i = node_i.index;
+      }
+      else
+      {
+        first_j = j + 1;
+        second_j = node_j.index;
+      }
+
+      if (top + 2 > STACK_SIZE)
+      {
+        // The local stack is full, visit the children pairs on a new one
+        this->intersection(tree, transform_in, first_i, first_j, intersection_list, swap_tree);
+        this->intersection(tree, transform_in, second_i, second_j, intersection_list, swap_tree);
+        continue;
+      }
+      stack_i[top] = second_i;
+      stack_j[top] = second_j;
+      ++top;
+      stack_i[top] = first_i;
+      stack_j[top] = first_j;
+      ++top;
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      aabb const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+
+    node query;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      query.min[k] = box.min(k);
+      query.max[k] = box.max(k);
+    }
+
+    size_t size = candidate_list.size();
+    this->intersection(query, 0, candidate_list);
+    this->count(0, 0, candidate_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      ray const &ray_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+
+    real origin[3];
+    real inv_direction[3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      origin[k] = ray_in.origin()[k];
+      inv_direction[k] = 1.0 / ray_in.direction()[k];
+    }
+
+    size_t size = candidate_list.size();
+    this->intersection(origin, inv_direction, 0, candidate_list);
+    this->count(0, 0, candidate_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      plane const &plane_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    real normal[3] = {plane_in.normal().x(), plane_in.normal().y(), plane_in.normal().z()};
+    real offset = plane_in.normal().dot(plane_in.origin());
+    size_t size = candidate_list.size();
+    this->halfSpace(normal, offset, 0, nullptr, candidate_list);
+    this->count(0, 0, candidate_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::halfSpace(
+      plane const &plane_in,
+      aabb::vecptr &inside_list,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    real normal[3] = {plane_in.normal().x(), plane_in.normal().y(), plane_in.normal().z()};
+    real offset = plane_in.normal().dot(plane_in.origin());
+    size_t size = inside_list.size() + candidate_list.size();
+    this->halfSpace(normal, offset, 0, &inside_list, candidate_list);
+    this->count(0, 0, inside_list.size() + candidate_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      ball const &ball_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    size_t size = candidate_list.size();
+    this->intersection(ball_in.center(), ball_in.radius(), 0, candidate_list);
+    this->count(0, 0, candidate_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      node const &query,
+      integer i,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      i = stack[--top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      if (!intersects(node_i, query))
+        continue;
+      if (node_i.count > 0)
+      {
+        tested += node_i.count;
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+          if (node_i.count == 1 || intersects(boxNode(*this->m_boxes[b]), query))
+            candidate_list.push_back(this->m_boxes[b]);
+        continue;
+      }
+      // The local stack is full, visit the left child on a new one
+      if (top + 2 > STACK_SIZE)
+        this->intersection(query, i + 1, candidate_list);
+      else
+        stack[top++] = i + 1;
+      stack[top++] = node_i.index;
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      real const origin[3],
+      real const inv_direction[3],
+      integer i,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      i = stack[--top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      real t_entry;
+      if (!intersects(node_i, origin, inv_direction, INFTY, t_entry))
+        continue;
+      if (node_i.count > 0)
+      {
+        tested += node_i.count;
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+          if (node_i.count == 1 || intersects(boxNode(*this->m_boxes[b]), origin, inv_direction, INFTY, t_entry))
+            candidate_list.push_back(this->m_boxes[b]);
+        continue;
+      }
+      // The local stack is full, visit the left child on a new one
+      if (top + 2 > STACK_SIZE)
+        this->intersection(origin, inv_direction, i + 1, candidate_list);
+      else
+        stack[top++] = i + 1;
+      stack[top++] = node_i.index;
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::selfIntersection(
+      aabb::vecpairptr &intersection_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    size_t size = intersection_list.size();
+    this->selfIntersection(0, 0, intersection_list);
+    this->count(0, 0, intersection_list.size() - size);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::selfIntersection(
+      integer i,
+      integer j,
+      aabb::vecpairptr &intersection_list)
+      const
+  {
+    // A pair (i, i) stands for the subtree against itself, the other pairs
+    // always have i in the left part of the array, so that i < j
+    integer stack_i[STACK_SIZE];
+    integer stack_j[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack_i[top] = i;
+    stack_j[top] = j;
+    ++top;
+    while (top > 0)
+    {
+      --top;
+      i = stack_i[top];
+      j = stack_j[top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      node const &node_j = this->m_nodes[j];
+
+      integer size = 0;
+      integer child_i[4];
+      integer child_j[4];
+      if (i == j)
+      {
+        if (node_i.count > 0)
+        {
+          tested += node_i.count * (node_i.count - 1) / 2;
+          for (integer a = node_i.index; a < node_i.index + node_i.count; ++a)
+            for (integer b = a + 1; b < node_i.index + node_i.count; ++b)
+              if (this->m_boxes[a]->intersects(*this->m_boxes[b]))
+                intersection_list.push_back(aabb::pairptr(this->m_boxes[a], this->m_boxes[b]));
+          continue;
+        }
+        child_i[size] = node_i.index, child_j[size++] = node_i.index;
+        child_i[size] = i + 1, child_j[size++] = node_i.index;
+        child_i[size] = i + 1, child_j[size++] = i + 1;
+      }
+      else
+      {
+        if (!intersects(node_i, node_j))
+          continue;
+        integer icase = (node_i.count > 0 ? 0 : 1) + (node_j.count > 0 ? 0 : 2);
+        switch (icase)
+        {
+        case 0: // Both are leafs
+          tested += node_i.count * node_j.count;
+          for (integer a = node_i.index; a < node_i.index + node_i.count; ++a)
+            for (integer b = node_j.index; b < node_j.index + node_j.count; ++b)
+              if (node_i.count + node_j.count == 2 || this->m_boxes[a]->intersects(*this->m_boxes[b]))
+                intersection_list.push_back(aabb::pairptr(this->m_boxes[a], this->m_boxes[b]));
+          break;
+        case 1: // First is a tree, second is a leaf
+          child_i[size] = node_i.index, child_j[size++] = j;
+          child_i[size] = i + 1, child_j[size++] = j;
+          break;
+        case 2: // First leaf, second is a tree
+          child_i[size] = i, child_j[size++] = node_j.index;
+          child_i[size] = i, child_j[size++] = j + 1;
+          break;
+        case 3: // First is a tree, second is a tree
+          child_i[size] = node_i.index, child_j[size++] = node_j.index;
+          child_i[size] = node_i.index, child_j[size++] = j + 1;
+          child_i[size] = i + 1, child_j[size++] = node_j.index;
+          child_i[size] = i + 1, child_j[size++] = j + 1;
+          break;
+        }
+      }
+
+      if (top + size > STACK_SIZE)
+      {
+        // The local stack is full, visit the children pairs on a new one
+        for (integer k = size - 1; k >= 0; --k)
+          this->selfIntersection(child_i[k], child_j[k], intersection_list);
+        continue;
+      }
+      for (integer k = 0; k < size; ++k, ++top)
+      {
+        stack_i[top] = child_i[k];
+        stack_j[top] = child_j[k];
+      }
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::parallelIntersection(
+      AABBtree const &tree,
+      aabb::vecpairptr &intersection_list,
+      bool deterministic,
+      bool swap_tree)
+      const
+  {
+    if (this->isEmpty() || tree.isEmpty())
+      return;
+
+#ifdef _OPENMP
+    if (this->m_nodes.size() + tree.m_nodes.size() < PARALLEL_QUERY_SIZE)
+#endif
+    {
+      size_t size = intersection_list.size();
+      this->intersection(tree, 0, 0, intersection_list, swap_tree);
+      this->count(0, 0, intersection_list.size() - size);
+      return;
+    }
+
+    // Expand the top levels of the traversal keeping the serial visiting order
+    // (the frontier size does not depend on the number of threads)
+    std::vector<std::pair<integer, integer>> frontier;
+    std::vector<std::pair<integer, integer>> expanded;
+    frontier.push_back(std::make_pair(0, 0));
+    size_t visited = 0;
+    bool expand = true;
+    while (expand && frontier.size() < PARALLEL_FRONTIER)
+    {
+      expand = false;
+      expanded.clear();
+      std::vector<std::pair<integer, integer>>::const_iterator it;
+      for (it = frontier.begin(); it != frontier.end(); ++it)
+      {
+        integer i = it->first;
+        integer j = it->second;
+        node const &node_i = this->m_nodes[i];
+        node const &node_j = tree.m_nodes[j];
+        if (!intersects(node_i, node_j))
+        {
+          ++visited;
+          continue;
+        }
+        // The pairs of leaves are carried to the next level and the pairs of the
+        // final frontier are visited again by the kernels, count them only there
+        integer icase = (node_i.count > 0 ? 0 : 1) + (node_j.count > 0 ? 0 : 2);
+        if (icase > 0)
+          ++visited;
+        switch (icase)
+        {
+        case 0: // Both are leafs
+          expanded.push_back(*it);
+          break;
+        case 1: // First is a tree, second is a leaf
+          expanded.push_back(std::make_pair(i + 1, j));
+          expanded.push_back(std::make_pair(node_i.index, j));
+          break;
+        case 2: // First leaf, second is a tree
+          expanded.push_back(std::make_pair(i, j + 1));
+          expanded.push_back(std::make_pair(i, node_j.index));
+          break;
+        case 3: // First is a tree, second is a tree
+          expanded.push_back(std::make_pair(i + 1, j + 1));
+          expanded.push_back(std::make_pair(i + 1, node_j.index));
+          expanded.push_back(std::make_pair(node_i.index, j + 1));
+          expanded.push_back(std::make_pair(node_i.index, node_j.index));
+          break;
+        }
+        expand = expand || icase > 0;
+      }
+      frontier.swap(expanded);
+    }
+
+    integer size = frontier.size();
+    integer buffers_size = 1;
+#ifdef _OPENMP
+    buffers_size = deterministic ? size : omp_get_max_threads();
+#endif
+    std::vector<aabb::vecpairptr> buffers(buffers_size);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (integer k = 0; k < size; ++k)
+    {
+      integer b = 0;
+#ifdef _OPENMP
+      b = deterministic ? k : omp_get_thread_num();
+#endif
+      this->intersection(tree, frontier[k].first, frontier[k].second, buffers[b], swap_tree);
+    }
+
+    // Merge the output buffers
+    size_t first = intersection_list.size();
+    size_t total = first;
+    std::vector<aabb::vecpairptr>::const_iterator it;
+    for (it = buffers.begin(); it != buffers.end(); ++it)
+      total += it->size();
+    intersection_list.reserve(total);
+    for (it = buffers.begin(); it != buffers.end(); ++it)
+      intersection_list.insert(intersection_list.end(), it->begin(), it->end());
+    this->count(visited, 0, total - first);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::halfSpace(
+      real const normal[3],
+      real offset,
+      integer i,
+      aabb::vecptr *inside_list,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      i = stack[--top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      integer node_side = side(node_i, normal, offset);
+      if (node_side < 0 || (node_side > 0 && inside_list == nullptr))
+        continue;
+      if (node_side > 0)
+      {
+        // Accept the whole subtree, its boxes are contiguous
+        integer first = i;
+        while (this->m_nodes[first].count == 0)
+          first = first + 1;
+        integer last = i;
+        while (this->m_nodes[last].count == 0)
+          last = this->m_nodes[last].index;
+        inside_list->insert(inside_list->end(),
+                            this->m_boxes.begin() + this->m_nodes[first].index,
+                            this->m_boxes.begin() + this->m_nodes[last].index + this->m_nodes[last].count);
+        continue;
+      }
+      if (node_i.count > 0)
+      {
+        tested += node_i.count;
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+        {
+          integer box_side = node_i.count == 1 ? 0 : side(boxNode(*this->m_boxes[b]), normal, offset);
+          if (box_side == 0)
+            candidate_list.push_back(this->m_boxes[b]);
+          else if (box_side > 0 && inside_list != nullptr)
+            inside_list->push_back(this->m_boxes[b]);
+        }
+        continue;
+      }
+      // The local stack is full, visit the left child on a new one
+      if (top + 2 > STACK_SIZE)
+        this->halfSpace(normal, offset, i + 1, inside_list, candidate_list);
+      else
+        stack[top++] = i + 1;
+      stack[top++] = node_i.index;
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::intersection(
+      point const &center,
+      real radius,
+      integer i,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    size_t visited = 0;
+    size_t tested = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      i = stack[--top];
+      ++visited;
+      node const &node_i = this->m_nodes[i];
+      if (boxDistance(node_i, center) > radius)
+        continue;
+      if (node_i.count > 0)
+      {
+        tested += node_i.count;
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+          if (node_i.count == 1 || boxDistance(boxNode(*this->m_boxes[b]), center) <= radius)
+            candidate_list.push_back(this->m_boxes[b]);
+        continue;
+      }
+      // The local stack is full, visit the left child on a new one
+      if (top + 2 > STACK_SIZE)
+        this->intersection(center, radius, i + 1, candidate_list);
+      else
+        stack[top++] = i + 1;
+      stack[top++] = node_i.index;
+    }
+    this->count(visited, tested, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  AABBtree::nearest(
+      point const &query,
+      integer k,
+      aabb::vecptr &candidate_list,
+      std::vector<real> &distance_list)
       const
   {
-    real distance = this->minimumExteriorDistance(query, *this, INFTY);
-    this->selectLessThanDistance(query, distance, *this, candidate_list);
+    this->nearest(
+        query, k,
+        [&query](aabb::ptr const &box) {
+          real dx = std::max(0.0, std::max(box->min(0) - query.x(), query.x() - box->max(0)));
+          real dy = std::max(0.0, std::max(box->min(1) - query.y(), query.y() - box->max(1)));
+          real dz = std::max(0.0, std::max(box->min(2) - query.z(), query.z() - box->max(2)));
+          return std::sqrt(dx * dx + dy * dy + dz * dz);
+        },
+        candidate_list, distance_list);
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
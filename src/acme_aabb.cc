@@ -355,6 +355,16 @@ namespace acme
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  real
+  aabb::area(void)
+      const
+  {
+    point size(this->m_max - this->m_min);
+    return 2.0 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
   void
   aabb::clamp(
       point const &point0_in,
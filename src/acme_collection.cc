@@ -980,6 +980,37 @@ namespace acme
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  void
+  collection::refitAABBtree(void)
+  {
+    aabb::vecptr ptrVecbox;
+    this->clamp(ptrVecbox);
+    this->m_AABBtree->refit(ptrVecbox);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::saveAABBtree(
+      std::string const &filename)
+      const
+  {
+    return this->m_AABBtree->save(filename);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::loadAABBtree(
+      std::string const &filename)
+  {
+    aabb::vecptr ptrVecbox;
+    this->clamp(ptrVecbox);
+    return this->m_AABBtree->load(filename, ptrVecbox);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
   AABBtree::ptr const &
   collection::ptrAABBtree(void)
   {
@@ -996,7 +1027,7 @@ namespace acme
   {
     candidates.clear();
     aabb::vecpairptr intersection_list;
-    this->m_AABBtree->intersection(*entities.ptrAABBtree(), intersection_list);
+    this->m_AABBtree->parallelIntersection(*entities.ptrAABBtree(), intersection_list);
     for (size_t i = 0; i < intersection_list.size(); ++i)
     {
       candidates.push_back(this->m_entities[(intersection_list[i].first)->id()]);
@@ -1007,6 +1038,48 @@ namespace acme
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  bool
+  collection::intersection(
+      collection &entities,
+      affine const &transform,
+      collection &candidates)
+      const
+  {
+    candidates.clear();
+    aabb::vecpairptr intersection_list;
+    this->m_AABBtree->intersection(*entities.ptrAABBtree(), transform, intersection_list);
+    for (size_t i = 0; i < intersection_list.size(); ++i)
+    {
+      candidates.push_back(this->m_entities[(intersection_list[i].first)->id()]);
+      candidates.push_back(entities[(intersection_list[i].second)->id()]);
+    }
+    return candidates.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::intersection(
+      collection &entities,
+      pairCache &cache,
+      collection &intersections,
+      real tolerance)
+      const
+  {
+    intersections.clear();
+    cache.update(this->m_entities, entities.m_entities, *this->m_AABBtree, *entities.ptrAABBtree(), tolerance);
+
+    pairCache::veccontact::const_iterator it;
+    for (it = cache.contacts().begin(); it != cache.contacts().end(); ++it)
+    {
+      if (!it->intersection->isNone())
+        intersections.push_back(it->intersection);
+    }
+    return intersections.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
   bool
   collection::intersection(
       AABBtree::ptr const &ptrAABBtree,
@@ -1015,7 +1088,7 @@ namespace acme
   {
     candidates.clear();
     aabb::vecpairptr intersection_list;
-    this->m_AABBtree->intersection(*ptrAABBtree, intersection_list);
+    this->m_AABBtree->parallelIntersection(*ptrAABBtree, intersection_list);
     for (size_t i = 0; i < intersection_list.size(); ++i)
       candidates.push_back(this->m_entities[(intersection_list[i].first)->id()]);
     return candidates.size() > 0;
@@ -1042,9 +1115,300 @@ namespace acme
       collection &candidates)
       const
   {
-    aabb::vecptr ptrVecbox;
-    ptrVecbox.push_back(ptrbox);
-    return this->intersection(ptrVecbox, candidates);
+    candidates.clear();
+    aabb::vecptr candidate_list;
+    this->m_AABBtree->intersection(*ptrbox, candidate_list);
+    for (size_t i = 0; i < candidate_list.size(); ++i)
+      candidates.push_back(this->m_entities[candidate_list[i]->id()]);
+    return candidates.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::within(
+      point const &query,
+      real radius,
+      std::vector<integer> &indices)
+      const
+  {
+    return this->within(ball(radius, query), indices);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::within(
+      ball const &ball_in,
+      std::vector<integer> &indices)
+      const
+  {
+    indices.clear();
+    aabb::vecptr candidate_list;
+    this->m_AABBtree->intersection(ball_in, candidate_list);
+    for (size_t i = 0; i < candidate_list.size(); ++i)
+    {
+      integer id = candidate_list[i]->id();
+      if (distance(ball_in.center(), this->m_entities[id].get()) <= ball_in.radius())
+        indices.push_back(id);
+    }
+    return indices.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Range of the signed distances of the points of an entity from a plane
+  static void
+  signedDistanceRange(
+      plane const &plane_in,
+      entity const *entity_in,
+      real &min,
+      real &max)
+  {
+    if (entity_in->isPoint())
+    {
+      min = max = plane_in.signedDistance(*dynamic_cast<point const *>(entity_in));
+    }
+    else if (entity_in->isSegment())
+    {
+      segment const &segment_in = *dynamic_cast<segment const *>(entity_in);
+      real d0 = plane_in.signedDistance(segment_in.vertex(0));
+      real d1 = plane_in.signedDistance(segment_in.vertex(1));
+      min = std::min(d0, d1);
+      max = std::max(d0, d1);
+    }
+    else if (entity_in->isTriangle())
+    {
+      triangle const &triangle_in = *dynamic_cast<triangle const *>(entity_in);
+      real d0 = plane_in.signedDistance(triangle_in.vertex(0));
+      real d1 = plane_in.signedDistance(triangle_in.vertex(1));
+      real d2 = plane_in.signedDistance(triangle_in.vertex(2));
+      min = std::min(d0, std::min(d1, d2));
+      max = std::max(d0, std::max(d1, d2));
+    }
+    else if (entity_in->isDisk())
+    {
+      disk const &disk_in = *dynamic_cast<disk const *>(entity_in);
+      real center = plane_in.signedDistance(disk_in.center());
+      real radius = disk_in.radius() * plane_in.normal().cross(disk_in.normal().normalized()).norm();
+      min = center - radius;
+      max = center + radius;
+    }
+    else if (entity_in->isBall())
+    {
+      ball const &ball_in = *dynamic_cast<ball const *>(entity_in);
+      real center = plane_in.signedDistance(ball_in.center());
+      real radius = ball_in.radius() * plane_in.normal().norm();
+      min = center - radius;
+      max = center + radius;
+    }
+    else
+    {
+      min = -INFTY;
+      max = INFTY;
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::slice(
+      plane const &plane_in,
+      std::vector<integer> &indices)
+      const
+  {
+    indices.clear();
+    aabb::vecptr candidate_list;
+    this->m_AABBtree->intersection(plane_in, candidate_list);
+    real min, max;
+    for (size_t i = 0; i < candidate_list.size(); ++i)
+    {
+      integer id = candidate_list[i]->id();
+      signedDistanceRange(plane_in, this->m_entities[id].get(), min, max);
+      if (min <= 0.0 && max >= 0.0)
+        indices.push_back(id);
+    }
+    return indices.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::halfSpace(
+      plane const &plane_in,
+      std::vector<integer> &indices)
+      const
+  {
+    indices.clear();
+    aabb::vecptr inside_list;
+    aabb::vecptr candidate_list;
+    this->m_AABBtree->halfSpace(plane_in, inside_list, candidate_list);
+    for (size_t i = 0; i < inside_list.size(); ++i)
+      indices.push_back(inside_list[i]->id());
+    real min, max;
+    for (size_t i = 0; i < candidate_list.size(); ++i)
+    {
+      integer id = candidate_list[i]->id();
+      signedDistanceRange(plane_in, this->m_entities[id].get(), min, max);
+      if (min > 0.0)
+        indices.push_back(id);
+    }
+    return indices.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::nearest(
+      point const &query,
+      integer k,
+      collection &candidates,
+      std::vector<real> &distances)
+      const
+  {
+    candidates.clear();
+    distances.clear();
+    aabb::vecptr candidate_list;
+    entity::vecptr const &entities = this->m_entities;
+    this->m_AABBtree->nearest(
+        query, k,
+        [&query, &entities](aabb::ptr const &box) {
+          return distance(query, entities[box->id()].get());
+        },
+        candidate_list, distances);
+    for (size_t i = 0; i < candidate_list.size(); ++i)
+      candidates.push_back(this->m_entities[candidate_list[i]->id()]);
+    return candidates.size() > 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::closest(
+      point const &query,
+      entity::ptr &entity_out,
+      real &distance_out)
+      const
+  {
+    collection candidates;
+    std::vector<real> distances;
+    if (!this->nearest(query, 1, candidates, distances))
+      return false;
+    entity_out = candidates[0];
+    distance_out = distances[0];
+    return true;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Ray parameter of the hit with an entity lower than t, with the barycentric
+  // coordinates for triangles
+  static bool
+  raycastEntity(
+      ray const &ray_in,
+      entity const *entity_in,
+      real &t,
+      real &u,
+      real &v,
+      real &w)
+  {
+    vec3 const &direction = ray_in.direction();
+    if (entity_in->isTriangle())
+    {
+      triangle const &triangle_in = *dynamic_cast<triangle const *>(entity_in);
+      vec3 edge1(triangle_in.vertex(1) - triangle_in.vertex(0));
+      vec3 edge2(triangle_in.vertex(2) - triangle_in.vertex(0));
+      vec3 p(direction.cross(edge2));
+      // The determinant scales with the edges and the direction, so the ray is
+      // parallel to the triangle relative to their lengths
+      real det = edge1.dot(p);
+      if (std::abs(det) <= EPSILON_MACHINE * direction.norm() * edge1.norm() * edge2.norm())
+        return false;
+      real inv_det = 1.0 / det;
+      vec3 s(ray_in.origin() - triangle_in.vertex(0));
+      real b1 = s.dot(p) * inv_det;
+      if (b1 < 0.0 || b1 > 1.0)
+        return false;
+      vec3 q(s.cross(edge1));
+      real b2 = direction.dot(q) * inv_det;
+      if (b2 < 0.0 || b1 + b2 > 1.0)
+        return false;
+      real t_hit = edge2.dot(q) * inv_det;
+      if (t_hit < 0.0 || t_hit >= t)
+        return false;
+      t = t_hit;
+      u = 1.0 - b1 - b2;
+      v = b1;
+      w = b2;
+      return true;
+    }
+    else if (entity_in->isDisk())
+    {
+      disk const &disk_in = *dynamic_cast<disk const *>(entity_in);
+      real den = direction.dot(disk_in.normal());
+      if (std::abs(den) <= EPSILON_MACHINE * direction.norm() * disk_in.normal().norm())
+        return false;
+      real t_hit = (disk_in.center() - ray_in.origin()).dot(disk_in.normal()) / den;
+      if (t_hit < 0.0 || t_hit >= t)
+        return false;
+      vec3 radial(ray_in.origin() + t_hit * direction - disk_in.center());
+      if (radial.squaredNorm() > disk_in.radius() * disk_in.radius())
+        return false;
+      t = t_hit;
+      u = v = w = QUIET_NAN;
+      return true;
+    }
+    else if (entity_in->isBall())
+    {
+      ball const &ball_in = *dynamic_cast<ball const *>(entity_in);
+      vec3 s(ray_in.origin() - ball_in.center());
+      real a = direction.squaredNorm();
+      real b = s.dot(direction);
+      real c = s.squaredNorm() - ball_in.radius() * ball_in.radius();
+      real delta = b * b - a * c;
+      if (delta < 0.0)
+        return false;
+      // The origin inside the ball is a hit at zero
+      real t_hit = c <= 0.0 ? 0.0 : (-b - std::sqrt(delta)) / a;
+      if (t_hit < 0.0 || t_hit >= t)
+        return false;
+      t = t_hit;
+      u = v = w = QUIET_NAN;
+      return true;
+    }
+    return false;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::raycast(
+      ray const &ray_in,
+      integer &index_out,
+      real &t_out,
+      real &u_out,
+      real &v_out,
+      real &w_out,
+      real t_max,
+      bool any_hit)
+      const
+  {
+    entity::vecptr const &entities = this->m_entities;
+    aabb::ptr box;
+    real u, v, w;
+    bool hit = this->m_AABBtree->raycast(
+        ray_in, t_max,
+        [&ray_in, &entities, &u, &v, &w](aabb::ptr const &box_in, real &t) {
+          return raycastEntity(ray_in, entities[box_in->id()].get(), t, u, v, w);
+        },
+        any_hit, box, t_out);
+    if (!hit)
+      return false;
+    // Recompute the barycentric coordinates of the closest hit
+    real t = INFTY;
+    index_out = box->id();
+    raycastEntity(ray_in, this->m_entities[index_out].get(), t, u_out, v_out, w_out);
+    return true;
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -1055,13 +1419,97 @@ namespace acme
       real tolerance)
       const
   {
-    int size = this->m_entities.size();
     entities.clear();
-    for (size_t i = 0; i < size; ++i)
-      for (size_t j = i; j < size; ++j)
-        entities.push_back(entity::ptr(acme::intersection(this->m_entities[i].get(),
-                                                          this->m_entities[j].get(),
-                                                          tolerance)));
+    AABBtree::ptr ptrAABBtree(this->m_AABBtree);
+    if (ptrAABBtree->isEmpty())
+    {
+      aabb::vecptr ptrVecbox;
+      this->clamp(ptrVecbox);
+      ptrAABBtree = std::make_shared<AABBtree>();
+      ptrAABBtree->build(ptrVecbox);
+    }
+    aabb::vecpairptr intersection_list;
+    ptrAABBtree->selfIntersection(intersection_list);
+    for (size_t i = 0; i < intersection_list.size(); ++i)
+    {
+      entity::ptr entity_out(acme::intersection(this->m_entities[intersection_list[i].first->id()].get(),
+                                                this->m_entities[intersection_list[i].second->id()].get(),
+                                                tolerance));
+      if (!entity_out->isNone())
+        entities.push_back(entity_out);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  collection::sweptBoxes(
+      affine const &start,
+      affine const &end,
+      aabb::vecptr &boxes)
+      const
+  {
+    boxes.clear();
+    aabb box;
+    for (size_t i = 0; i < this->m_entities.size(); ++i)
+    {
+      if (!sweep(this->m_entities[i].get(), start, end, box))
+        continue;
+      box.id() = i;
+      boxes.push_back(std::make_shared<aabb>(box));
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  collection::timeOfImpact(
+      affine const &start,
+      affine const &end,
+      collection const &entities,
+      affine const &entities_start,
+      affine const &entities_end,
+      integer &i,
+      integer &j,
+      real &toi,
+      real tolerance)
+      const
+  {
+    aabb::vecptr boxes, entities_boxes;
+    this->sweptBoxes(start, end, boxes);
+    entities.sweptBoxes(entities_start, entities_end, entities_boxes);
+    if (boxes.empty() || entities_boxes.empty())
+      return false;
+    AABBtree tree, entities_tree;
+    tree.build(boxes);
+    entities_tree.build(entities_boxes);
+    // The earliest impact found bounds the advancement of the next pairs
+    bool hit = false;
+    toi = 1.0;
+    entity::vecptr const &entities0 = this->m_entities;
+    entity::vecptr const &entities1 = entities.m_entities;
+    tree.visitIntersection(
+        entities_tree,
+        [&](integer position0, integer position1) {
+          integer index0 = boxes[position0]->id();
+          integer index1 = entities_boxes[position1]->id();
+          // A pair for which the advancement does not converge is reported at
+          // the lower bound of its time of impact, so the motion can be safely
+          // advanced up to the returned time without stepping through it
+          real t = INFTY;
+          acme::timeOfImpact(entities0[index0].get(), start, end,
+                             entities1[index1].get(), entities_start, entities_end,
+                             t, toi, tolerance);
+          if (t < INFTY && (!hit || t < toi))
+          {
+            hit = true;
+            toi = t;
+            i = index0;
+            j = index1;
+          }
+          return hit && toi <= 0.0;
+        });
+    return hit;
   }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -0,0 +1,314 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_distance.cc
+///
+
+#include "acme_distance.hh"
+
+namespace acme
+{
+
+  /*\
+   |   ____  _     _                       
+   |  |  _ \(_)___| |_ __ _ _ __   ___ ___ 
+   |  | | | | / __| __/ _` | '_ \ / __/ _ \
+   |  | |_| | \__ \ || (_| | | | | (_|  __/
+   |  |____/|_|___/\__\__,_|_| |_|\___\___|
+   |                                       
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      entity const *entity_in)
+  {
+    if (entity_in->isPoint())
+      return distance(point_in, *dynamic_cast<point const *>(entity_in));
+    else if (entity_in->isLine())
+      return distance(point_in, *dynamic_cast<line const *>(entity_in));
+    else if (entity_in->isRay())
+      return distance(point_in, *dynamic_cast<ray const *>(entity_in));
+    else if (entity_in->isPlane())
+      return distance(point_in, *dynamic_cast<plane const *>(entity_in));
+    else if (entity_in->isSegment())
+      return distance(point_in, *dynamic_cast<segment const *>(entity_in));
+    else if (entity_in->isTriangle())
+      return distance(point_in, *dynamic_cast<triangle const *>(entity_in));
+    else if (entity_in->isDisk())
+      return distance(point_in, *dynamic_cast<disk const *>(entity_in));
+    else if (entity_in->isBall())
+      return distance(point_in, *dynamic_cast<ball const *>(entity_in));
+    else
+      return INFTY;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point0_in,
+      point const &point1_in)
+  {
+    return (point1_in - point0_in).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      line const &line_in)
+  {
+    vec3 direction(line_in.direction().normalized());
+    vec3 difference(point_in - line_in.origin());
+    return (difference - difference.dot(direction) * direction).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      ray const &ray_in)
+  {
+    vec3 direction(ray_in.direction().normalized());
+    vec3 difference(point_in - ray_in.origin());
+    real t = std::max(0.0, difference.dot(direction));
+    return (difference - t * direction).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      plane const &plane_in)
+  {
+    return plane_in.distance(point_in);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      segment const &segment_in)
+  {
+    vec3 edge(segment_in.vertex(1) - segment_in.vertex(0));
+    vec3 difference(point_in - segment_in.vertex(0));
+    real length2 = edge.squaredNorm();
+    real t = 0.0;
+    if (length2 > EPSILON_MACHINE)
+      t = std::max(0.0, std::min(1.0, difference.dot(edge) / length2));
+    return (difference - t * edge).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      triangle const &triangle_in)
+  {
+    // Closest point by Voronoi regions of the triangle features
+    point const &a = triangle_in.vertex(0);
+    point const &b = triangle_in.vertex(1);
+    point const &c = triangle_in.vertex(2);
+    vec3 ab(b - a);
+    vec3 ac(c - a);
+    vec3 ap(point_in - a);
+    real d1 = ab.dot(ap);
+    real d2 = ac.dot(ap);
+    if (d1 <= 0.0 && d2 <= 0.0)
+      return ap.norm();
+
+    vec3 bp(point_in - b);
+    real d3 = ab.dot(bp);
+    real d4 = ac.dot(bp);
+    if (d3 >= 0.0 && d4 <= d3)
+      return bp.norm();
+
+    real vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+      return (ap - d1 / (d1 - d3) * ab).norm();
+
+    vec3 cp(point_in - c);
+    real d5 = ab.dot(cp);
+    real d6 = ac.dot(cp);
+    if (d6 >= 0.0 && d5 <= d6)
+      return cp.norm();
+
+    real vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+      return (ap - d2 / (d2 - d6) * ac).norm();
+
+    real va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+      return (bp - (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b)).norm();
+
+    real denom = 1.0 / (va + vb + vc);
+    return (ap - vb * denom * ab - vc * denom * ac).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      disk const &disk_in)
+  {
+    vec3 normal(disk_in.normal().normalized());
+    vec3 difference(point_in - disk_in.center());
+    real height = difference.dot(normal);
+    real radial = (difference - height * normal).norm();
+    real outside = std::max(0.0, radial - disk_in.radius());
+    return std::sqrt(height * height + outside * outside);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      point const &point_in,
+      ball const &ball_in)
+  {
+    return std::max(0.0, (point_in - ball_in.center()).norm() - ball_in.radius());
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      segment const &segment0_in,
+      segment const &segment1_in)
+  {
+    // Closest points of two segments (Ericson, Real-Time Collision Detection)
+    point const &p0 = segment0_in.vertex(0);
+    point const &p1 = segment1_in.vertex(0);
+    vec3 d0(segment0_in.vertex(1) - p0);
+    vec3 d1(segment1_in.vertex(1) - p1);
+    vec3 r(p0 - p1);
+    real a = d0.dot(d0);
+    real e = d1.dot(d1);
+    real f = d1.dot(r);
+    real s, t;
+    if (a <= EPSILON_MACHINE && e <= EPSILON_MACHINE)
+      return r.norm();
+    if (a <= EPSILON_MACHINE)
+    {
+      s = 0.0;
+      t = std::min(1.0, std::max(0.0, f / e));
+    }
+    else
+    {
+      real c = d0.dot(r);
+      if (e <= EPSILON_MACHINE)
+      {
+        t = 0.0;
+        s = std::min(1.0, std::max(0.0, -c / a));
+      }
+      else
+      {
+        real b = d0.dot(d1);
+        real denom = a * e - b * b;
+        s = denom > 0.0 ? std::min(1.0, std::max(0.0, (b * f - c * e) / denom)) : 0.0;
+        t = (b * s + f) / e;
+        if (t < 0.0)
+        {
+          t = 0.0;
+          s = std::min(1.0, std::max(0.0, -c / a));
+        }
+        else if (t > 1.0)
+        {
+          t = 1.0;
+          s = std::min(1.0, std::max(0.0, (b - c) / a));
+        }
+      }
+    }
+    return (r + s * d0 - t * d1).norm();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      segment const &segment_in,
+      triangle const &triangle_in)
+  {
+    // The closest points are on the segment endpoints or on the triangle
+    // edges, unless the segment crosses the triangle
+    point const &p = segment_in.vertex(0);
+    point const &q = segment_in.vertex(1);
+    real result = std::min(distance(p, triangle_in), distance(q, triangle_in));
+    for (size_t k = 0; k < 3; ++k)
+    {
+      segment edge(triangle_in.vertex(k), triangle_in.vertex((k + 1) % 3));
+      result = std::min(result, distance(segment_in, edge));
+    }
+    point const &a = triangle_in.vertex(0);
+    vec3 normal((triangle_in.vertex(1) - a).cross(triangle_in.vertex(2) - a));
+    real dp = normal.dot(p - a);
+    real dq = normal.dot(q - a);
+    if ((dp < 0.0 && dq > 0.0) || (dp > 0.0 && dq < 0.0))
+    {
+      point crossing(p + dp / (dp - dq) * (q - p));
+      result = std::min(result, distance(crossing, triangle_in));
+    }
+    return result;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  distance(
+      triangle const &triangle0_in,
+      triangle const &triangle1_in)
+  {
+    // The closest points of two disjoint triangles lie on an edge of one of
+    // them, intersecting triangles have an edge that crosses the other one
+    real result = INFTY;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      segment edge0(triangle0_in.vertex(k), triangle0_in.vertex((k + 1) % 3));
+      segment edge1(triangle1_in.vertex(k), triangle1_in.vertex((k + 1) % 3));
+      result = std::min(result, distance(edge0, triangle1_in));
+      result = std::min(result, distance(edge1, triangle0_in));
+    }
+    return result;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_distance.cc
+///
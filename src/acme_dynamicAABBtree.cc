@@ -0,0 +1,496 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_dynamicAABBtree.cc
+///
+
+#include "acme_dynamicAABBtree.hh"
+
+namespace acme
+{
+
+  /*\
+   |       _                             _         _        _    ____  ____  _                 
+   |    __| |_   _ _ __   __ _ _ __ ___ (_) ___   / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |   / _` | | | | '_ \ / _` | '_ ` _ \| |/ __| / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |  | (_| | |_| | | | | (_| | | | | | | | (__ / ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |   \__,_|\__, |_| |_|\__,_|_| |_| |_|_|\___/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |         |___/                                                                             
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  dynamicAABBtree::~dynamicAABBtree()
+  {
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  dynamicAABBtree::dynamicAABBtree(
+      real margin)
+      : m_root(-1),
+        m_free(-1),
+        m_size(0),
+        m_margin(margin)
+  {
+    ACME_ASSERT(margin >= 0.0,
+                "acme::dynamicAABBtree::dynamicAABBtree(): negative margin.")
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::clear(void)
+  {
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+    this->m_root = -1;
+    this->m_free = -1;
+    this->m_size = 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  dynamicAABBtree::isEmpty(void)
+      const
+  {
+    return this->m_root < 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  dynamicAABBtree::size(void)
+      const
+  {
+    return this->m_size;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  dynamicAABBtree::height(void)
+      const
+  {
+    return this->m_root < 0 ? 0 : this->m_nodes[this->m_root].height;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  dynamicAABBtree::margin(void)
+      const
+  {
+    return this->m_margin;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  dynamicAABBtree::insert(
+      aabb::ptr const &box)
+  {
+    integer leaf = this->allocate();
+    node &node_leaf = this->m_nodes[leaf];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      node_leaf.min[k] = box->min(k) - this->m_margin;
+      node_leaf.max[k] = box->max(k) + this->m_margin;
+    }
+    node_leaf.height = 0;
+    this->m_boxes[leaf] = box;
+    this->insertLeaf(leaf);
+    ++this->m_size;
+    return leaf;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::remove(
+      integer id)
+  {
+    ACME_ASSERT(id >= 0 && id < integer(this->m_nodes.size()) && this->m_nodes[id].height == 0,
+                "acme::dynamicAABBtree::remove(): invalid box identifier.")
+    this->removeLeaf(id);
+    this->release(id);
+    --this->m_size;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  dynamicAABBtree::move(
+      integer id,
+      aabb::ptr const &box)
+  {
+    ACME_ASSERT(id >= 0 && id < integer(this->m_nodes.size()) && this->m_nodes[id].height == 0,
+                "acme::dynamicAABBtree::move(): invalid box identifier.")
+    this->m_boxes[id] = box;
+
+    // The fattened box still contains the moved box
+    node &node_id = this->m_nodes[id];
+    bool inside = true;
+    for (size_t k = 0; k < 3; ++k)
+      inside = inside && node_id.min[k] <= box->min(k) && node_id.max[k] >= box->max(k);
+    if (inside)
+      return false;
+
+    this->removeLeaf(id);
+    for (size_t k = 0; k < 3; ++k)
+    {
+      node_id.min[k] = box->min(k) - this->m_margin;
+      node_id.max[k] = box->max(k) + this->m_margin;
+    }
+    this->insertLeaf(id);
+    return true;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::ptr const &
+  dynamicAABBtree::box(
+      integer id)
+      const
+  {
+    return this->m_boxes[id];
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  dynamicAABBtree::vecnode const &
+  dynamicAABBtree::nodes(void)
+      const
+  {
+    return this->m_nodes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::intersection(
+      AABBtree const &tree,
+      aabb::vecpairptr &intersection_list,
+      bool swap_tree)
+      const
+  {
+    // Collect all the pairs through the collision kernel
+    this->collision(
+        tree,
+        [&intersection_list](aabb::ptr const &box0, aabb::ptr const &box1)
+        {
+          intersection_list.push_back(aabb::pairptr(box0, box1));
+          return false;
+        },
+        swap_tree);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::intersection(
+      aabb const &box_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    std::vector<integer> stack;
+    stack.push_back(this->m_root);
+    while (!stack.empty())
+    {
+      integer i = stack.back();
+      stack.pop_back();
+      node const &node_i = this->m_nodes[i];
+      if (node_i.min[0] > box_in.max(0) || node_i.max[0] < box_in.min(0) ||
+          node_i.min[1] > box_in.max(1) || node_i.max[1] < box_in.min(1) ||
+          node_i.min[2] > box_in.max(2) || node_i.max[2] < box_in.min(2))
+        continue;
+      if (node_i.left < 0)
+      {
+        if (this->m_boxes[i]->intersects(box_in))
+          candidate_list.push_back(this->m_boxes[i]);
+      }
+      else
+      {
+        stack.push_back(node_i.right);
+        stack.push_back(node_i.left);
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  dynamicAABBtree::allocate(void)
+  {
+    integer i = this->m_free;
+    if (i < 0)
+    {
+      i = this->m_nodes.size();
+      this->m_nodes.push_back(node());
+      this->m_boxes.push_back(aabb::ptr());
+    }
+    else
+    {
+      this->m_free = this->m_nodes[i].parent;
+    }
+    node &node_i = this->m_nodes[i];
+    node_i.parent = -1;
+    node_i.left = -1;
+    node_i.right = -1;
+    node_i.height = 0;
+    return i;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::release(
+      integer i)
+  {
+    node &node_i = this->m_nodes[i];
+    node_i.parent = this->m_free;
+    node_i.height = -1;
+    this->m_boxes[i].reset();
+    this->m_free = i;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::insertLeaf(
+      integer leaf)
+  {
+    if (this->m_root < 0)
+    {
+      this->m_root = leaf;
+      this->m_nodes[leaf].parent = -1;
+      return;
+    }
+
+    // Find the best sibling with the surface area heuristic
+    node leaf_box = this->m_nodes[leaf];
+    integer i = this->m_root;
+    while (this->m_nodes[i].left >= 0)
+    {
+      node const &node_i = this->m_nodes[i];
+      node merged = node_i;
+      for (size_t k = 0; k < 3; ++k)
+      {
+        merged.min[k] = std::min(node_i.min[k], leaf_box.min[k]);
+        merged.max[k] = std::max(node_i.max[k], leaf_box.max[k]);
+      }
+      real node_area = area(node_i);
+      real merged_area = area(merged);
+
+      // Cost of creating a new parent for this node and the new leaf
+      real cost = 2.0 * merged_area;
+
+      // Minimum cost of pushing the leaf further down the tree
+      real inheritance_cost = 2.0 * (merged_area - node_area);
+
+      real child_cost[2];
+      integer child[2] = {node_i.left, node_i.right};
+      for (size_t c = 0; c < 2; ++c)
+      {
+        node const &node_c = this->m_nodes[child[c]];
+        for (size_t k = 0; k < 3; ++k)
+        {
+          merged.min[k] = std::min(node_c.min[k], leaf_box.min[k]);
+          merged.max[k] = std::max(node_c.max[k], leaf_box.max[k]);
+        }
+        child_cost[c] = area(merged) + inheritance_cost;
+        if (node_c.left >= 0)
+          child_cost[c] -= area(node_c);
+      }
+
+      // Descend according to the minimum cost
+      if (cost < child_cost[0] && cost < child_cost[1])
+        break;
+      i = child_cost[0] < child_cost[1] ? child[0] : child[1];
+    }
+
+    // Create a new parent for the sibling and the leaf
+    integer sibling = i;
+    integer old_parent = this->m_nodes[sibling].parent;
+    integer new_parent = this->allocate();
+    node &node_p = this->m_nodes[new_parent];
+    node_p.parent = old_parent;
+    node_p.left = sibling;
+    node_p.right = leaf;
+    this->m_nodes[sibling].parent = new_parent;
+    this->m_nodes[leaf].parent = new_parent;
+    if (old_parent < 0)
+      this->m_root = new_parent;
+    else if (this->m_nodes[old_parent].left == sibling)
+      this->m_nodes[old_parent].left = new_parent;
+    else
+      this->m_nodes[old_parent].right = new_parent;
+
+    this->refit(new_parent);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::removeLeaf(
+      integer leaf)
+  {
+    if (leaf == this->m_root)
+    {
+      this->m_root = -1;
+      return;
+    }
+
+    integer parent = this->m_nodes[leaf].parent;
+    integer grand_parent = this->m_nodes[parent].parent;
+    integer sibling = this->m_nodes[parent].left == leaf
+                          ? this->m_nodes[parent].right
+                          : this->m_nodes[parent].left;
+
+    // Replace the parent with the sibling
+    this->m_nodes[sibling].parent = grand_parent;
+    if (grand_parent < 0)
+      this->m_root = sibling;
+    else if (this->m_nodes[grand_parent].left == parent)
+      this->m_nodes[grand_parent].left = sibling;
+    else
+      this->m_nodes[grand_parent].right = sibling;
+    this->release(parent);
+
+    if (grand_parent >= 0)
+      this->refit(grand_parent);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::refit(
+      integer i)
+  {
+    while (i >= 0)
+    {
+      i = this->balance(i);
+      this->merge(i);
+      i = this->m_nodes[i].parent;
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  dynamicAABBtree::balance(
+      integer a)
+  {
+    node &node_a = this->m_nodes[a];
+    if (node_a.left < 0 || node_a.height < 2)
+      return a;
+
+    integer b = node_a.left;
+    integer c = node_a.right;
+    integer unbalance = this->m_nodes[c].height - this->m_nodes[b].height;
+
+    // Rotate the taller child up, its lower child replaces it under a
+    integer up;
+    if (unbalance > 1)
+      up = c;
+    else if (unbalance < -1)
+      up = b;
+    else
+      return a;
+
+    node &node_up = this->m_nodes[up];
+    integer f = node_up.left;
+    integer g = node_up.right;
+
+    // Swap a and up
+    node_up.parent = node_a.parent;
+    node_a.parent = up;
+    if (node_up.parent < 0)
+      this->m_root = up;
+    else if (this->m_nodes[node_up.parent].left == a)
+      this->m_nodes[node_up.parent].left = up;
+    else
+      this->m_nodes[node_up.parent].right = up;
+
+    // Keep the taller grandchild under up, move the other one under a
+    integer keep = this->m_nodes[f].height > this->m_nodes[g].height ? f : g;
+    integer give = keep == f ? g : f;
+    node_up.left = a;
+    node_up.right = keep;
+    if (up == c)
+      node_a.right = give;
+    else
+      node_a.left = give;
+    this->m_nodes[give].parent = a;
+
+    this->merge(a);
+    this->merge(up);
+    return up;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  dynamicAABBtree::merge(
+      integer i)
+  {
+    node &node_i = this->m_nodes[i];
+    node const &node_l = this->m_nodes[node_i.left];
+    node const &node_r = this->m_nodes[node_i.right];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      node_i.min[k] = std::min(node_l.min[k], node_r.min[k]);
+      node_i.max[k] = std::max(node_l.max[k], node_r.max[k]);
+    }
+    node_i.height = 1 + std::max(node_l.height, node_r.height);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  dynamicAABBtree::area(
+      node const &node_in)
+  {
+    real dx = node_in.max[0] - node_in.min[0];
+    real dy = node_in.max[1] - node_in.min[1];
+    real dz = node_in.max[2] - node_in.min[2];
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_dynamicAABBtree.cc
+///
@@ -0,0 +1,449 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_hashGrid.cc
+///
+
+#include "acme_hashGrid.hh"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace acme
+{
+
+  static integer const PARALLEL_BUILD_SIZE = 16384; //!< Minimum number of boxes to build a hash grid in parallel
+  static integer const LARGE_BOX_CELLS = 4096;      //!< Maximum number of cells spanned by a box in the grid
+  static real const CELL_RANGE = 1.0e15;            //!< Maximum absolute cell coordinate of a box in the grid
+
+  /*\
+   |   _               _      ____      _     _ 
+   |  | |__   __ _ ___| |__  / ___|_ __(_) __| |
+   |  | '_ \ / _` / __| '_ \| |  _| '__| |/ _` |
+   |  | | | | (_| \__ \ | | | |_| | |  | | (_| |
+   |  |_| |_|\__,_|___/_| |_|\____|_|  |_|\__,_|
+   |                                            
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  hashGrid::~hashGrid()
+  {
+    this->m_boxes.clear();
+    this->m_keys.clear();
+    this->m_entries.clear();
+    this->m_large.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  hashGrid::hashGrid(
+      real cell_size)
+      : m_cell_size(cell_size)
+  {
+    ACME_ASSERT(cell_size > 0.0,
+                "acme::hashGrid::hashGrid(): the cell size must be positive.")
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::clear(void)
+  {
+    this->m_boxes.clear();
+    this->m_keys.clear();
+    this->m_entries.clear();
+    this->m_large.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  hashGrid::isEmpty(void)
+      const
+  {
+    return this->m_boxes.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::setCellSize(
+      real cell_size)
+  {
+    ACME_ASSERT(cell_size > 0.0,
+                "acme::hashGrid::setCellSize(): the cell size must be positive.")
+    this->clear();
+    this->m_cell_size = cell_size;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  real
+  hashGrid::cellSize(void)
+      const
+  {
+    return this->m_cell_size;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::build(
+      aabb::vecptr const &boxes)
+  {
+    clear();
+
+    if (boxes.empty())
+      return;
+
+    // Count the cells of every box, the entries of a box start at the prefix
+    // sum of the counts, so that the boxes are inserted independently
+    integer size = boxes.size();
+    std::vector<size_t> offsets(size + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for if (size > PARALLEL_BUILD_SIZE)
+#endif
+    for (integer b = 0; b < size; ++b)
+    {
+      aabb const &box = *boxes[b];
+      if (this->isLarge(box))
+        continue;
+      size_t count = 1;
+      for (size_t k = 0; k < 3; ++k)
+        count *= this->cell(box.max(k)) - this->cell(box.min(k)) + 1;
+      offsets[b + 1] = count;
+    }
+    for (integer b = 0; b < size; ++b)
+    {
+      if (offsets[b + 1] == 0)
+        this->m_large.push_back(b);
+      offsets[b + 1] += offsets[b];
+    }
+
+    std::vector<std::pair<uint64_t, integer>> entries(offsets[size]);
+#ifdef _OPENMP
+#pragma omp parallel for if (size > PARALLEL_BUILD_SIZE)
+#endif
+    for (integer b = 0; b < size; ++b)
+    {
+      if (offsets[b + 1] == offsets[b])
+        continue;
+      aabb const &box = *boxes[b];
+      int64_t min_x = this->cell(box.min(0)), max_x = this->cell(box.max(0));
+      int64_t min_y = this->cell(box.min(1)), max_y = this->cell(box.max(1));
+      int64_t min_z = this->cell(box.min(2)), max_z = this->cell(box.max(2));
+      size_t n = offsets[b];
+      for (int64_t x = min_x; x <= max_x; ++x)
+        for (int64_t y = min_y; y <= max_y; ++y)
+          for (int64_t z = min_z; z <= max_z; ++z)
+            entries[n++] = std::make_pair(key(x, y, z), b);
+    }
+
+    // Entries of the same cell are sorted by box index
+    std::sort(entries.begin(), entries.end());
+    this->m_boxes = boxes;
+    this->m_keys.resize(entries.size());
+    this->m_entries.resize(entries.size());
+    for (size_t n = 0; n < entries.size(); ++n)
+    {
+      this->m_keys[n] = entries[n].first;
+      this->m_entries[n] = entries[n].second;
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::vecptr const &
+  hashGrid::boxes(void)
+      const
+  {
+    return this->m_boxes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  hashGrid::cells(void)
+      const
+  {
+    integer count = 0;
+    for (size_t n = 0; n < this->m_keys.size(); ++n)
+      if (n == 0 || this->m_keys[n] != this->m_keys[n - 1])
+        ++count;
+    return count;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::intersection(
+      hashGrid const &grid,
+      aabb::vecpairptr &intersection_list,
+      bool swap_grid)
+      const
+  {
+    ACME_ASSERT(this->m_cell_size == grid.m_cell_size,
+                "acme::hashGrid::intersection(): the hash grids have different cell sizes.")
+
+    // Merge the cells of the two grids in key order
+    size_t i = 0;
+    size_t j = 0;
+    size_t size_i = this->m_keys.size();
+    size_t size_j = grid.m_keys.size();
+    while (i < size_i && j < size_j)
+    {
+      uint64_t key_i = this->m_keys[i];
+      uint64_t key_j = grid.m_keys[j];
+      if (key_i < key_j)
+      {
+        ++i;
+        continue;
+      }
+      if (key_j < key_i)
+      {
+        ++j;
+        continue;
+      }
+      size_t last_i = i;
+      while (last_i < size_i && this->m_keys[last_i] == key_i)
+        ++last_i;
+      size_t last_j = j;
+      while (last_j < size_j && grid.m_keys[last_j] == key_j)
+        ++last_j;
+      for (size_t a = i; a < last_i; ++a)
+      {
+        aabb::ptr const &box_a = this->m_boxes[this->m_entries[a]];
+        for (size_t b = j; b < last_j; ++b)
+        {
+          aabb::ptr const &box_b = grid.m_boxes[grid.m_entries[b]];
+          if (!box_a->intersects(*box_b) || this->overlapKey(*box_a, *box_b) != key_i)
+            continue;
+          if (swap_grid)
+            intersection_list.push_back(aabb::pairptr(box_b, box_a));
+          else
+            intersection_list.push_back(aabb::pairptr(box_a, box_b));
+        }
+      }
+      i = last_i;
+      j = last_j;
+    }
+
+    // The boxes out of the grids are checked against all the other boxes
+    for (size_t l = 0; l < this->m_large.size(); ++l)
+    {
+      aabb::ptr const &box_a = this->m_boxes[this->m_large[l]];
+      for (size_t b = 0; b < grid.m_boxes.size(); ++b)
+      {
+        aabb::ptr const &box_b = grid.m_boxes[b];
+        if (!box_a->intersects(*box_b))
+          continue;
+        if (swap_grid)
+          intersection_list.push_back(aabb::pairptr(box_b, box_a));
+        else
+          intersection_list.push_back(aabb::pairptr(box_a, box_b));
+      }
+    }
+    for (size_t l = 0; l < grid.m_large.size(); ++l)
+    {
+      aabb::ptr const &box_b = grid.m_boxes[grid.m_large[l]];
+      for (size_t a = 0; a < this->m_boxes.size(); ++a)
+      {
+        aabb::ptr const &box_a = this->m_boxes[a];
+        if (this->isLarge(*box_a) || !box_a->intersects(*box_b))
+          continue;
+        if (swap_grid)
+          intersection_list.push_back(aabb::pairptr(box_b, box_a));
+        else
+          intersection_list.push_back(aabb::pairptr(box_a, box_b));
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::selfIntersection(
+      aabb::vecpairptr &intersection_list)
+      const
+  {
+    size_t size = this->m_keys.size();
+    for (size_t first = 0; first < size;)
+    {
+      uint64_t key_first = this->m_keys[first];
+      size_t last = first + 1;
+      while (last < size && this->m_keys[last] == key_first)
+        ++last;
+      for (size_t a = first; a < last; ++a)
+      {
+        aabb::ptr const &box_a = this->m_boxes[this->m_entries[a]];
+        for (size_t b = a + 1; b < last; ++b)
+        {
+          aabb::ptr const &box_b = this->m_boxes[this->m_entries[b]];
+          if (box_a->intersects(*box_b) && this->overlapKey(*box_a, *box_b) == key_first)
+            intersection_list.push_back(aabb::pairptr(box_a, box_b));
+        }
+      }
+      first = last;
+    }
+
+    // The boxes out of the grid are checked against all the other boxes, the
+    // pairs of them only once
+    integer size_boxes = this->m_boxes.size();
+    for (size_t l = 0; l < this->m_large.size(); ++l)
+    {
+      integer a = this->m_large[l];
+      aabb::ptr const &box_a = this->m_boxes[a];
+      for (integer b = 0; b < size_boxes; ++b)
+      {
+        aabb::ptr const &box_b = this->m_boxes[b];
+        if (b == a || (b < a && this->isLarge(*box_b)))
+          continue;
+        if (box_a->intersects(*box_b))
+          intersection_list.push_back(aabb::pairptr(box_a, box_b));
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  hashGrid::intersection(
+      aabb const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+
+    // A query box too large for the grid is checked against all the boxes
+    if (this->isLarge(box))
+    {
+      for (size_t b = 0; b < this->m_boxes.size(); ++b)
+        if (this->m_boxes[b]->intersects(box))
+          candidate_list.push_back(this->m_boxes[b]);
+      return;
+    }
+    for (size_t l = 0; l < this->m_large.size(); ++l)
+    {
+      aabb::ptr const &box_l = this->m_boxes[this->m_large[l]];
+      if (box_l->intersects(box))
+        candidate_list.push_back(box_l);
+    }
+
+    int64_t min_x = this->cell(box.min(0)), max_x = this->cell(box.max(0));
+    int64_t min_y = this->cell(box.min(1)), max_y = this->cell(box.max(1));
+    int64_t min_z = this->cell(box.min(2)), max_z = this->cell(box.max(2));
+    for (int64_t x = min_x; x <= max_x; ++x)
+    {
+      for (int64_t y = min_y; y <= max_y; ++y)
+      {
+        for (int64_t z = min_z; z <= max_z; ++z)
+        {
+          uint64_t key_xyz = key(x, y, z);
+          std::vector<uint64_t>::const_iterator first, last;
+          first = std::lower_bound(this->m_keys.begin(), this->m_keys.end(), key_xyz);
+          last = std::upper_bound(first, this->m_keys.end(), key_xyz);
+          for (; first != last; ++first)
+          {
+            aabb::ptr const &box_n = this->m_boxes[this->m_entries[first - this->m_keys.begin()]];
+            if (box_n->intersects(box) && this->overlapKey(*box_n, box) == key_xyz)
+              candidate_list.push_back(box_n);
+          }
+        }
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  hashGrid::isLarge(
+      aabb const &box)
+      const
+  {
+    // The negated comparison also catches the non-finite coordinates and the
+    // inverted boxes, which would otherwise span a negative number of cells
+    real count = 1.0;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      real min = box.min(k) / this->m_cell_size;
+      real max = box.max(k) / this->m_cell_size;
+      if (!(min >= -CELL_RANGE && min <= max && max <= CELL_RANGE))
+        return true;
+      count *= std::floor(max) - std::floor(min) + 1.0;
+    }
+    return count > LARGE_BOX_CELLS;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  int64_t
+  hashGrid::cell(
+      real coordinate)
+      const
+  {
+    return static_cast<int64_t>(std::floor(coordinate / this->m_cell_size));
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  uint64_t
+  hashGrid::key(
+      int64_t x,
+      int64_t y,
+      int64_t z)
+  {
+    // Pack the lower 21 bits of every coordinate, the cells that share a key
+    // are more than two million cells apart, so a box in the grid never
+    // enters the same key twice
+    uint64_t mask = 0x1FFFFF;
+    return (uint64_t(x) & mask) << 42 | (uint64_t(y) & mask) << 21 | (uint64_t(z) & mask);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  uint64_t
+  hashGrid::overlapKey(
+      aabb const &box0,
+      aabb const &box1)
+      const
+  {
+    return key(this->cell(std::max(box0.min(0), box1.min(0))),
+               this->cell(std::max(box0.min(1), box1.min(1))),
+               this->cell(std::max(box0.min(2), box1.min(2))));
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_hashGrid.cc
+///
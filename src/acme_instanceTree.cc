@@ -0,0 +1,294 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_instanceTree.cc
+///
+
+#include "acme_instanceTree.hh"
+
+namespace acme
+{
+
+  /*\
+   |   _           _                      _____              
+   |  (_)_ __  ___| |_ __ _ _ __   ___ __|_   _| __ ___  ___ 
+   |  | | '_ \/ __| __/ _` | '_ \ / __/ _ \| || '__/ _ \/ _ \
+   |  | | | | \__ \ || (_| | | | | (_|  __/| || | |  __/  __/
+   |  |_|_| |_|___/\__\__,_|_| |_|\___\___||_||_|  \___|\___|
+   |                                                         
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Box of the transformed corners of a box, computed from the transformed
+  // center and the extents projected on the absolute linear part
+  static aabb::ptr
+  transformBox(
+      real const min[3],
+      real const max[3],
+      affine const &transform,
+      integer id)
+  {
+    vec3 center, extent;
+    for (integer k = 0; k < 3; ++k)
+    {
+      center[k] = 0.5 * (min[k] + max[k]);
+      extent[k] = 0.5 * (max[k] - min[k]);
+    }
+    point center_out(transform * center);
+    point extent_out(transform.linear().cwiseAbs() * extent);
+    return std::make_shared<aabb>(point(center_out - extent_out), point(center_out + extent_out), id, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Ray in the frame of an instance, the direction is not normalized so that
+  // the ray parameter is the same in both frames
+  static ray
+  transformRay(
+      ray const &ray_in,
+      affine const &transform)
+  {
+    return ray(point(transform * ray_in.origin()), vec3(transform.linear() * ray_in.direction()));
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  instanceTree::~instanceTree()
+  {
+    this->clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  instanceTree::instanceTree()
+  {
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::clear(void)
+  {
+    this->m_instances.clear();
+    this->m_boxes.clear();
+    this->m_tree.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  instanceTree::isEmpty(void)
+      const
+  {
+    return this->m_instances.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  instanceTree::size(void)
+      const
+  {
+    return this->m_instances.size();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  instanceTree::add(
+      collection::ptr const &mesh,
+      affine const &transform)
+  {
+    ACME_ASSERT(mesh && mesh->size() > 0,
+                "acme::instanceTree::add(): empty mesh.")
+    if (mesh->ptrAABBtree()->isEmpty())
+      mesh->buildAABBtree();
+    instance instance_in;
+    instance_in.mesh = mesh;
+    instance_in.transform = transform;
+    instance_in.inverse = transform.inverse();
+    this->m_instances.push_back(instance_in);
+    return this->m_instances.size() - 1;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  instanceTree::instance const &
+  instanceTree::getInstance(
+      integer i)
+      const
+  {
+    return this->m_instances[i];
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::setTransform(
+      integer i,
+      affine const &transform)
+  {
+    this->m_instances[i].transform = transform;
+    this->m_instances[i].inverse = transform.inverse();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::ptr
+  instanceTree::instanceBox(
+      integer i)
+      const
+  {
+    AABBtree::node const &root = this->m_instances[i].mesh->ptrAABBtree()->nodes()[0];
+    return transformBox(root.min, root.max, this->m_instances[i].transform, i);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::build(void)
+  {
+    integer size = this->m_instances.size();
+    this->m_boxes.resize(size);
+    for (integer i = 0; i < size; ++i)
+      this->m_boxes[i] = this->instanceBox(i);
+    this->m_tree.build(this->m_boxes);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::refit(void)
+  {
+    ACME_ASSERT(this->m_boxes.size() == this->m_instances.size(),
+                "acme::instanceTree::refit(): instances added after the last build.")
+    for (size_t i = 0; i < this->m_boxes.size(); ++i)
+      this->m_boxes[i] = this->instanceBox(i);
+    this->m_tree.refit(this->m_boxes);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree const &
+  instanceTree::tree(void)
+      const
+  {
+    return this->m_tree;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::intersection(
+      aabb const &box,
+      vecpair &candidate_list)
+      const
+  {
+    aabb::vecptr instances;
+    this->m_tree.intersection(box, instances);
+    aabb::vecptr boxes;
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+      integer id = instances[i]->id();
+      instance const &instance_in = this->m_instances[id];
+      aabb::ptr box_local(transformBox(box.min().data(), box.max().data(), instance_in.inverse, 0));
+      boxes.clear();
+      instance_in.mesh->ptrAABBtree()->intersection(*box_local, boxes);
+      // Discard the mesh boxes that do not overlap the query as oriented boxes
+      AABBtree::relative transform_in;
+      AABBtree::relativeTransform(instance_in.transform, transform_in);
+      for (size_t j = 0; j < boxes.size(); ++j)
+        if (AABBtree::intersects(box.min().data(), box.max().data(),
+                                 boxes[j]->min().data(), boxes[j]->max().data(), transform_in))
+          candidate_list.push_back(std::make_pair(id, boxes[j]->id()));
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  instanceTree::intersection(
+      ray const &ray_in,
+      vecpair &candidate_list)
+      const
+  {
+    aabb::vecptr instances;
+    this->m_tree.intersection(ray_in, instances);
+    aabb::vecptr boxes;
+    for (size_t i = 0; i < instances.size(); ++i)
+    {
+      integer id = instances[i]->id();
+      instance const &instance_in = this->m_instances[id];
+      boxes.clear();
+      instance_in.mesh->ptrAABBtree()->intersection(transformRay(ray_in, instance_in.inverse), boxes);
+      for (size_t j = 0; j < boxes.size(); ++j)
+        candidate_list.push_back(std::make_pair(id, boxes[j]->id()));
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  instanceTree::raycast(
+      ray const &ray_in,
+      integer &instance_out,
+      integer &index_out,
+      real &t_out,
+      real &u_out,
+      real &v_out,
+      real &w_out,
+      real t_max,
+      bool any_hit)
+      const
+  {
+    // Every hit accepted by the top-level traversal is closer than the
+    // previous ones, so the last one is the closest
+    vecinstance const &instances = this->m_instances;
+    aabb::ptr box;
+    bool hit = this->m_tree.raycast(
+        ray_in, t_max,
+        [&](aabb::ptr const &box_in, real &t) {
+          instance const &instance_in = instances[box_in->id()];
+          if (!instance_in.mesh->raycast(transformRay(ray_in, instance_in.inverse),
+                                         index_out, t, u_out, v_out, w_out, t, any_hit))
+            return false;
+          instance_out = box_in->id();
+          return true;
+        },
+        any_hit, box, t_out);
+    return hit;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_instanceTree.cc
+///
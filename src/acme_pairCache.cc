@@ -0,0 +1,403 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_pairCache.cc
+///
+
+#include "acme_pairCache.hh"
+
+namespace acme
+{
+
+  /*\
+   |               _       ____           _          
+   |   _ __   __ _(_)_ __ / ___|__ _  ___| |__   ___ 
+   |  | '_ \ / _` | | '__| |   / _` |/ __| '_ \ / _ \
+   |  | |_) | (_| | | |  | |__| (_| | (__| | | |  __/
+   |  | .__/ \__,_|_|_|   \____\__,_|\___|_| |_|\___|
+   |  |_|                                            
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Geometric state of an entity: a type code followed by its defining values
+  static void
+  state(
+      entity const *entity_in,
+      real state_out[pairCache::STATE_SIZE])
+  {
+    std::fill(state_out, state_out + pairCache::STATE_SIZE, 0.0);
+    state_out[0] = entity_in->isNone() ? 0 : entity_in->level();
+    real *values = state_out + 1;
+    if (entity_in->isPoint())
+    {
+      point const &point_in = *dynamic_cast<point const *>(entity_in);
+      std::copy(point_in.data(), point_in.data() + 3, values);
+    }
+    else if (entity_in->isLine())
+    {
+      line const &line_in = *dynamic_cast<line const *>(entity_in);
+      std::copy(line_in.origin().data(), line_in.origin().data() + 3, values);
+      std::copy(line_in.direction().data(), line_in.direction().data() + 3, values + 3);
+    }
+    else if (entity_in->isRay())
+    {
+      ray const &ray_in = *dynamic_cast<ray const *>(entity_in);
+      std::copy(ray_in.origin().data(), ray_in.origin().data() + 3, values);
+      std::copy(ray_in.direction().data(), ray_in.direction().data() + 3, values + 3);
+    }
+    else if (entity_in->isPlane())
+    {
+      plane const &plane_in = *dynamic_cast<plane const *>(entity_in);
+      std::copy(plane_in.origin().data(), plane_in.origin().data() + 3, values);
+      std::copy(plane_in.normal().data(), plane_in.normal().data() + 3, values + 3);
+    }
+    else if (entity_in->isSegment())
+    {
+      segment const &segment_in = *dynamic_cast<segment const *>(entity_in);
+      for (integer k = 0; k < 2; ++k)
+        std::copy(segment_in.vertex(k).data(), segment_in.vertex(k).data() + 3, values + 3 * k);
+    }
+    else if (entity_in->isTriangle())
+    {
+      triangle const &triangle_in = *dynamic_cast<triangle const *>(entity_in);
+      for (integer k = 0; k < 3; ++k)
+        std::copy(triangle_in.vertex(k).data(), triangle_in.vertex(k).data() + 3, values + 3 * k);
+    }
+    else if (entity_in->isDisk())
+    {
+      disk const &disk_in = *dynamic_cast<disk const *>(entity_in);
+      std::copy(disk_in.center().data(), disk_in.center().data() + 3, values);
+      std::copy(disk_in.normal().data(), disk_in.normal().data() + 3, values + 3);
+      values[6] = disk_in.radius();
+    }
+    else if (entity_in->isBall())
+    {
+      ball const &ball_in = *dynamic_cast<ball const *>(entity_in);
+      std::copy(ball_in.center().data(), ball_in.center().data() + 3, values);
+      values[3] = ball_in.radius();
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // LSD radix sort of the pair keys on 8-bit digits, the digits shared by all
+  // the keys (as the high bits of small entity indices) are skipped
+  static void
+  radixSort(
+      std::vector<uint64_t> &keys,
+      std::vector<uint64_t> &buffer)
+  {
+    size_t size = keys.size();
+    if (size < 2)
+      return;
+    buffer.resize(size);
+    size_t histogram[256];
+    for (integer shift = 0; shift < 64; shift += 8)
+    {
+      std::fill(histogram, histogram + 256, 0);
+      for (size_t k = 0; k < size; ++k)
+        ++histogram[(keys[k] >> shift) & 0xFF];
+      if (histogram[(keys[0] >> shift) & 0xFF] == size)
+        continue;
+      size_t offset = 0;
+      for (size_t d = 0; d < 256; ++d)
+      {
+        size_t count = histogram[d];
+        histogram[d] = offset;
+        offset += count;
+      }
+      for (size_t k = 0; k < size; ++k)
+        buffer[histogram[(keys[k] >> shift) & 0xFF]++] = keys[k];
+      keys.swap(buffer);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::~pairCache()
+  {
+    this->clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::pairCache()
+      : m_step(0),
+        m_computed(0),
+        m_tolerance(QUIET_NAN)
+  {
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  pairCache::clear(void)
+  {
+    this->m_contacts.clear();
+    this->m_merged.clear();
+    this->m_boxes.clear();
+    this->m_keys.clear();
+    this->m_sorting.clear();
+    this->m_added.clear();
+    this->m_persisting.clear();
+    this->m_removed.clear();
+    for (size_t k = 0; k < 2; ++k)
+    {
+      this->m_states[k].clear();
+      this->m_checked[k].clear();
+      this->m_moved[k].clear();
+    }
+    this->m_computed = 0;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  pairCache::isEmpty(void)
+      const
+  {
+    return this->m_contacts.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  pairCache::size(void)
+      const
+  {
+    return this->m_contacts.size();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  pairCache::update(
+      entity::vecptr const &entities0,
+      entity::vecptr const &entities1,
+      vecpair const &candidates,
+      real tolerance)
+  {
+    this->m_keys.resize(candidates.size());
+    for (size_t k = 0; k < candidates.size(); ++k)
+      this->m_keys[k] = key(candidates[k].first, candidates[k].second);
+    this->merge(entities0, entities1, tolerance);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  pairCache::update(
+      entity::vecptr const &entities0,
+      entity::vecptr const &entities1,
+      AABBtree const &tree0,
+      AABBtree const &tree1,
+      real tolerance)
+  {
+    // The keys are sorted afterwards, the serial ordering is not needed
+    this->m_boxes.clear();
+    tree0.parallelIntersection(tree1, this->m_boxes, false);
+    this->m_keys.resize(this->m_boxes.size());
+    for (size_t k = 0; k < this->m_boxes.size(); ++k)
+      this->m_keys[k] = key(this->m_boxes[k].first->id(), this->m_boxes[k].second->id());
+    // Keep the capacity, not the boxes
+    this->m_boxes.clear();
+    this->merge(entities0, entities1, tolerance);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  pairCache::merge(
+      entity::vecptr const &entities0,
+      entity::vecptr const &entities1,
+      real tolerance)
+  {
+    ++this->m_step;
+    this->m_added.clear();
+    this->m_persisting.clear();
+    this->m_removed.clear();
+    this->m_computed = 0;
+
+    // A different tolerance invalidates all the cached intersections
+    bool invalid = !(tolerance == this->m_tolerance);
+    this->m_tolerance = tolerance;
+
+    // The entities never checked count as moved
+    entity::vecptr const *entities[2] = {&entities0, &entities1};
+    for (size_t k = 0; k < 2; ++k)
+    {
+      size_t size = entities[k]->size();
+      this->m_states[k].resize(size * STATE_SIZE);
+      this->m_checked[k].resize(size, 0);
+      this->m_moved[k].resize(size, true);
+    }
+
+    radixSort(this->m_keys, this->m_sorting);
+    this->m_keys.erase(std::unique(this->m_keys.begin(), this->m_keys.end()), this->m_keys.end());
+
+    // Merge the sorted cached pairs with the sorted candidates
+    this->m_merged.clear();
+    this->m_merged.reserve(this->m_keys.size());
+    veccontact::iterator cached = this->m_contacts.begin();
+    std::vector<uint64_t>::const_iterator it;
+    for (it = this->m_keys.begin(); it != this->m_keys.end(); ++it)
+    {
+      for (; cached != this->m_contacts.end() && key(cached->first, cached->second) < *it; ++cached)
+        this->m_removed.push_back(std::make_pair(cached->first, cached->second));
+
+      contact contact_in;
+      contact_in.first = integer(*it >> 32);
+      contact_in.second = integer(*it & 0xFFFFFFFF);
+      entity const *entity0 = entities0[contact_in.first].get();
+      entity const *entity1 = entities1[contact_in.second].get();
+      bool moved0 = this->moved(entity0, 0, contact_in.first);
+      bool moved1 = this->moved(entity1, 1, contact_in.second);
+
+      bool persisting = cached != this->m_contacts.end() && key(cached->first, cached->second) == *it;
+      if (persisting)
+      {
+        this->m_persisting.push_back(std::make_pair(contact_in.first, contact_in.second));
+        contact_in.intersection.swap(cached->intersection);
+        ++cached;
+      }
+      else
+      {
+        this->m_added.push_back(std::make_pair(contact_in.first, contact_in.second));
+      }
+      if (!persisting || invalid || moved0 || moved1)
+      {
+        contact_in.intersection.reset(acme::intersection(entity0, entity1, tolerance));
+        ++this->m_computed;
+      }
+      this->m_merged.push_back(contact_in);
+    }
+    for (; cached != this->m_contacts.end(); ++cached)
+      this->m_removed.push_back(std::make_pair(cached->first, cached->second));
+    this->m_contacts.swap(this->m_merged);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  pairCache::moved(
+      entity const *entity_in,
+      integer side,
+      integer i)
+  {
+    if (this->m_checked[side][i] == this->m_step)
+      return this->m_moved[side][i];
+    real state_in[STATE_SIZE];
+    state(entity_in, state_in);
+    real *state_old = &this->m_states[side][i * STATE_SIZE];
+    // The state was recorded by the previous update only if the entity was a candidate
+    bool moved_in = this->m_checked[side][i] + 1 != this->m_step ||
+                    !std::equal(state_in, state_in + STATE_SIZE, state_old);
+    std::copy(state_in, state_in + STATE_SIZE, state_old);
+    this->m_checked[side][i] = this->m_step;
+    this->m_moved[side][i] = moved_in;
+    return moved_in;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::veccontact const &
+  pairCache::contacts(void)
+      const
+  {
+    return this->m_contacts;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::vecpair const &
+  pairCache::added(void)
+      const
+  {
+    return this->m_added;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::vecpair const &
+  pairCache::persisting(void)
+      const
+  {
+    return this->m_persisting;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  pairCache::vecpair const &
+  pairCache::removed(void)
+      const
+  {
+    return this->m_removed;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  size_t
+  pairCache::computed(void)
+      const
+  {
+    return this->m_computed;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  entity::ptr
+  pairCache::intersection(
+      integer i,
+      integer j)
+      const
+  {
+    // Binary search on the cached pairs sorted by key
+    uint64_t pair_key = key(i, j);
+    size_t first = 0;
+    size_t last = this->m_contacts.size();
+    while (first < last)
+    {
+      size_t middle = (first + last) / 2;
+      if (key(this->m_contacts[middle].first, this->m_contacts[middle].second) < pair_key)
+        first = middle + 1;
+      else
+        last = middle;
+    }
+    if (first == this->m_contacts.size() || this->m_contacts[first].first != i || this->m_contacts[first].second != j)
+      return entity::ptr();
+    return this->m_contacts[first].intersection;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_pairCache.cc
+///
@@ -0,0 +1,436 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_quantizedAABBtree.cc
+///
+
+#include "acme_quantizedAABBtree.hh"
+
+#include <cstring>
+
+namespace acme
+{
+
+  /*\
+   |                           _   _             _    _        _    ____  ____  _                 
+   |    __ _ _   _  __ _ _ __ | |_(_)_______  __| |  / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |   / _` | | | |/ _` | '_ \| __| |_  / _ \/ _` | / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |  | (_| | |_| | (_| | | | | |_| |/ /  __/ (_| |/ ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |   \__, |\__,_|\__,_|_| |_|\__|_/___\___|\__,_/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |      |_|                                                                                     
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Dequantize an offset, the last level is exactly the parent maximum
+  static inline real
+  decode(
+      integer q,
+      integer levels,
+      real min,
+      real max,
+      real step)
+  {
+    return q == levels ? max : min + q * step;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  quantizedAABBtree::~quantizedAABBtree()
+  {
+    this->m_nodes.clear();
+    this->m_bounds.clear();
+    this->m_boxes.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  quantizedAABBtree::quantizedAABBtree(
+      integer bits)
+      : m_bits(bits)
+  {
+    ACME_ASSERT(bits == 8 || bits == 16,
+                "acme::quantizedAABBtree::quantizedAABBtree(): only 8 or 16 bits are supported.")
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::clear(void)
+  {
+    this->m_nodes.clear();
+    this->m_bounds.clear();
+    this->m_boxes.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  quantizedAABBtree::isEmpty(void)
+      const
+  {
+    return this->m_nodes.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  quantizedAABBtree::bits(void)
+      const
+  {
+    return this->m_bits;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::build(
+      AABBtree const &tree)
+  {
+    clear();
+
+    if (tree.isEmpty())
+      return;
+
+    AABBtree::vecnode const &nodes = tree.nodes();
+    this->m_boxes = tree.boxes();
+    this->m_nodes.resize(nodes.size());
+    this->m_bounds.assign(6 * nodes.size() * (this->m_bits / 8), 0);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+      this->m_nodes[i].index = nodes[i].index;
+      this->m_nodes[i].count = nodes[i].count;
+    }
+
+    // The root box is stored exactly
+    this->m_root = nodes[0];
+    this->quantize(nodes, 0, this->m_root);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  size_t
+  quantizedAABBtree::memory(void)
+      const
+  {
+    return this->m_nodes.size() * sizeof(node) + this->m_bounds.size();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::vecptr const &
+  quantizedAABBtree::boxes(void)
+      const
+  {
+    return this->m_boxes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  AABBtree::node
+  quantizedAABBtree::nodeBox(
+      integer i)
+      const
+  {
+    // Dequantize the boxes along the path from the root
+    std::vector<integer> path;
+    integer j = 0;
+    while (j != i)
+    {
+      path.push_back(j);
+      integer right = this->m_nodes[j].index;
+      j = i < right ? j + 1 : right;
+    }
+    path.push_back(i);
+    AABBtree::node box = this->m_root;
+    for (size_t k = 1; k < path.size(); ++k)
+    {
+      AABBtree::node parent = box;
+      this->dequantize(path[k], parent, box);
+    }
+    box.index = this->m_nodes[i].index;
+    box.count = this->m_nodes[i].count;
+    return box;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  quantizedAABBtree::offset(
+      size_t i)
+      const
+  {
+    if (this->m_bits == 8)
+      return this->m_bounds[i];
+    uint16_t value;
+    std::memcpy(&value, &this->m_bounds[2 * i], sizeof(uint16_t));
+    return value;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::offset(
+      size_t i,
+      integer value)
+  {
+    if (this->m_bits == 8)
+    {
+      this->m_bounds[i] = static_cast<uint8_t>(value);
+      return;
+    }
+    uint16_t value16 = static_cast<uint16_t>(value);
+    std::memcpy(&this->m_bounds[2 * i], &value16, sizeof(uint16_t));
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::dequantize(
+      integer i,
+      AABBtree::node const &parent,
+      AABBtree::node &box)
+      const
+  {
+    integer levels = (1 << this->m_bits) - 1;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      real step = (parent.max[k] - parent.min[k]) / levels;
+      box.min[k] = decode(this->offset(6 * i + k), levels, parent.min[k], parent.max[k], step);
+      box.max[k] = decode(this->offset(6 * i + k + 3), levels, parent.min[k], parent.max[k], step);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::quantize(
+      AABBtree::vecnode const &nodes,
+      integer i,
+      AABBtree::node const &box)
+  {
+    if (nodes[i].count > 0)
+      return;
+
+    // Round outwards, then fix the rounding errors against the dequantization
+    // itself, so that the dequantized child box contains the child box
+    integer levels = (1 << this->m_bits) - 1;
+    integer children[2] = {i + 1, nodes[i].index};
+    for (size_t c = 0; c < 2; ++c)
+    {
+      AABBtree::node const &child = nodes[children[c]];
+      for (size_t k = 0; k < 3; ++k)
+      {
+        real step = (box.max[k] - box.min[k]) / levels;
+        integer q_min = 0;
+        integer q_max = levels;
+        if (step > 0.0)
+        {
+          q_min = static_cast<integer>(std::max(0.0, std::min<real>(levels, std::floor((child.min[k] - box.min[k]) / step))));
+          q_max = static_cast<integer>(std::max(0.0, std::min<real>(levels, std::ceil((child.max[k] - box.min[k]) / step))));
+          while (q_min > 0 && decode(q_min, levels, box.min[k], box.max[k], step) > child.min[k])
+            --q_min;
+          while (q_max < levels && decode(q_max, levels, box.min[k], box.max[k], step) < child.max[k])
+            ++q_max;
+        }
+        this->offset(6 * children[c] + k, q_min);
+        this->offset(6 * children[c] + k + 3, q_max);
+      }
+      AABBtree::node child_box;
+      this->dequantize(children[c], box, child_box);
+      this->quantize(nodes, children[c], child_box);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::intersection(
+      aabb const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    AABBtree::node query;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      query.min[k] = box.min(k);
+      query.max[k] = box.max(k);
+    }
+    if (AABBtree::intersects(this->m_root, query))
+      this->boxIntersection(query, 0, this->m_root, candidate_list);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::intersection(
+      ray const &ray_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    real origin[3];
+    real inv_direction[3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      origin[k] = ray_in.origin()[k];
+      inv_direction[k] = 1.0 / ray_in.direction()[k];
+    }
+    real t_entry;
+    if (AABBtree::intersects(this->m_root, origin, inv_direction, INFTY, t_entry))
+      this->rayIntersection(origin, inv_direction, 0, this->m_root, candidate_list);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::boxIntersection(
+      AABBtree::node const &query,
+      integer i,
+      AABBtree::node const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    // The stack stores the nodes that overlap the query with their dequantized box
+    integer stack[STACK_SIZE];
+    AABBtree::node stack_box[STACK_SIZE];
+    integer top = 0;
+    stack[top] = i;
+    stack_box[top] = box;
+    ++top;
+    while (top > 0)
+    {
+      --top;
+      i = stack[top];
+      node const &node_i = this->m_nodes[i];
+      if (node_i.count > 0)
+      {
+        // Check the exact boxes of the leaf
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+        {
+          aabb const &leaf = *this->m_boxes[b];
+          if (leaf.min(0) <= query.max[0] && leaf.max(0) >= query.min[0] &&
+              leaf.min(1) <= query.max[1] && leaf.max(1) >= query.min[1] &&
+              leaf.min(2) <= query.max[2] && leaf.max(2) >= query.min[2])
+            candidate_list.push_back(this->m_boxes[b]);
+        }
+        continue;
+      }
+      AABBtree::node parent = stack_box[top];
+      integer children[2] = {node_i.index, i + 1};
+      for (size_t c = 0; c < 2; ++c)
+      {
+        AABBtree::node child_box;
+        this->dequantize(children[c], parent, child_box);
+        if (!AABBtree::intersects(child_box, query))
+          continue;
+        if (top == STACK_SIZE)
+        {
+          // The local stack is full, visit the child on a new one
+          this->boxIntersection(query, children[c], child_box, candidate_list);
+          continue;
+        }
+        stack[top] = children[c];
+        stack_box[top] = child_box;
+        ++top;
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  quantizedAABBtree::rayIntersection(
+      real const origin[3],
+      real const inv_direction[3],
+      integer i,
+      AABBtree::node const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    // The stack stores the nodes hit by the ray with their dequantized box
+    integer stack[STACK_SIZE];
+    AABBtree::node stack_box[STACK_SIZE];
+    integer top = 0;
+    stack[top] = i;
+    stack_box[top] = box;
+    ++top;
+    real t_entry;
+    while (top > 0)
+    {
+      --top;
+      i = stack[top];
+      node const &node_i = this->m_nodes[i];
+      if (node_i.count > 0)
+      {
+        // Check the exact boxes of the leaf
+        for (integer b = node_i.index; b < node_i.index + node_i.count; ++b)
+        {
+          aabb const &leaf = *this->m_boxes[b];
+          AABBtree::node leaf_box;
+          for (size_t k = 0; k < 3; ++k)
+          {
+            leaf_box.min[k] = leaf.min(k);
+            leaf_box.max[k] = leaf.max(k);
+          }
+          if (AABBtree::intersects(leaf_box, origin, inv_direction, INFTY, t_entry))
+            candidate_list.push_back(this->m_boxes[b]);
+        }
+        continue;
+      }
+      AABBtree::node parent = stack_box[top];
+      integer children[2] = {node_i.index, i + 1};
+      for (size_t c = 0; c < 2; ++c)
+      {
+        AABBtree::node child_box;
+        this->dequantize(children[c], parent, child_box);
+        if (!AABBtree::intersects(child_box, origin, inv_direction, INFTY, t_entry))
+          continue;
+        if (top == STACK_SIZE)
+        {
+          // The local stack is full, visit the child on a new one
+          this->rayIntersection(origin, inv_direction, children[c], child_box, candidate_list);
+          continue;
+        }
+        stack[top] = children[c];
+        stack_box[top] = child_box;
+        ++top;
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_quantizedAABBtree.cc
+///
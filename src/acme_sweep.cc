@@ -0,0 +1,233 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_sweep.cc
+///
+
+#include "acme_sweep.hh"
+
+namespace acme
+{
+
+  static integer const MAX_ITERATIONS = 256; //!< Maximum number of conservative advancement steps
+
+  /*\
+   |   ____                         
+   |  / ___|_      _____  ___ _ __  
+   |  \___ \ \ /\ / / _ \/ _ \ '_ \ 
+   |   ___) \ V  V /  __/  __/ |_) |
+   |  |____/ \_/\_/ \___|\___| .__/ 
+   |                         |_|    
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Linear motion of the vertices of a point, segment, triangle or ball
+  struct motion
+  {
+    point start[3];  // Vertices in the start pose
+    point end[3];    // Vertices in the end pose
+    integer size;    // Number of vertices
+    real radius;     // Ball radius (zero for the other entities)
+  };
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Vertices of an entity in the start and end poses
+  static bool
+  vertices(
+      entity const *entity_in,
+      affine const &start,
+      affine const &end,
+      motion &motion_out)
+  {
+    point const *vertex[3];
+    motion_out.radius = 0.0;
+    if (entity_in->isPoint())
+    {
+      motion_out.size = 1;
+      vertex[0] = dynamic_cast<point const *>(entity_in);
+    }
+    else if (entity_in->isSegment())
+    {
+      segment const *segment_in = dynamic_cast<segment const *>(entity_in);
+      motion_out.size = 2;
+      vertex[0] = &segment_in->vertex(0);
+      vertex[1] = &segment_in->vertex(1);
+    }
+    else if (entity_in->isTriangle())
+    {
+      triangle const *triangle_in = dynamic_cast<triangle const *>(entity_in);
+      motion_out.size = 3;
+      vertex[0] = &triangle_in->vertex(0);
+      vertex[1] = &triangle_in->vertex(1);
+      vertex[2] = &triangle_in->vertex(2);
+    }
+    else if (entity_in->isBall())
+    {
+      ball const *ball_in = dynamic_cast<ball const *>(entity_in);
+      motion_out.size = 1;
+      motion_out.radius = ball_in->radius();
+      vertex[0] = &ball_in->center();
+    }
+    else
+    {
+      return false;
+    }
+    for (integer k = 0; k < motion_out.size; ++k)
+    {
+      motion_out.start[k] = start * (*vertex[k]);
+      motion_out.end[k] = end * (*vertex[k]);
+    }
+    return true;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Largest vertex displacement between the start and end poses
+  static real
+  speed(
+      motion const &motion_in)
+  {
+    real result = 0.0;
+    for (integer k = 0; k < motion_in.size; ++k)
+      result = std::max(result, (motion_in.end[k] - motion_in.start[k]).norm());
+    return result;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Distance of two moving entities at a given time (negative if balls overlap)
+  static real
+  separation(
+      motion const &motion0,
+      motion const &motion1,
+      real t)
+  {
+    // Sort the entities by number of vertices
+    motion const &m0 = motion0.size <= motion1.size ? motion0 : motion1;
+    motion const &m1 = motion0.size <= motion1.size ? motion1 : motion0;
+    point v0[3];
+    point v1[3];
+    for (integer k = 0; k < m0.size; ++k)
+      v0[k] = (1.0 - t) * m0.start[k] + t * m0.end[k];
+    for (integer k = 0; k < m1.size; ++k)
+      v1[k] = (1.0 - t) * m1.start[k] + t * m1.end[k];
+
+    real result;
+    if (m0.size == 1 && m1.size == 1)
+      result = distance(v0[0], v1[0]);
+    else if (m0.size == 1 && m1.size == 2)
+      result = distance(v0[0], segment(v1[0], v1[1]));
+    else if (m0.size == 1)
+      result = distance(v0[0], triangle(v1[0], v1[1], v1[2]));
+    else if (m0.size == 2 && m1.size == 2)
+      result = distance(segment(v0[0], v0[1]), segment(v1[0], v1[1]));
+    else if (m0.size == 2)
+      result = distance(segment(v0[0], v0[1]), triangle(v1[0], v1[1], v1[2]));
+    else
+      result = distance(triangle(v0[0], v0[1], v0[2]), triangle(v1[0], v1[1], v1[2]));
+    return result - m0.radius - m1.radius;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  sweep(
+      entity const *entity_in,
+      affine const &start,
+      affine const &end,
+      aabb &box)
+  {
+    motion motion_in;
+    if (!vertices(entity_in, start, end, motion_in))
+      return false;
+    point min(motion_in.start[0]);
+    point max(motion_in.start[0]);
+    for (integer k = 0; k < motion_in.size; ++k)
+    {
+      min = min.cwiseMin(motion_in.start[k]).cwiseMin(motion_in.end[k]);
+      max = max.cwiseMax(motion_in.start[k]).cwiseMax(motion_in.end[k]);
+    }
+    vec3 radius(vec3::Constant(motion_in.radius));
+    box.min() = min - radius;
+    box.max() = max + radius;
+    return true;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  timeOfImpact(
+      entity const *entity0_in,
+      affine const &start0,
+      affine const &end0,
+      entity const *entity1_in,
+      affine const &start1,
+      affine const &end1,
+      real &toi,
+      real t_max,
+      real tolerance)
+  {
+    motion motion0;
+    motion motion1;
+    if (!vertices(entity0_in, start0, end0, motion0) ||
+        !vertices(entity1_in, start1, end1, motion1))
+      return false;
+
+    // Any point of an entity moves as a convex combination of its vertices,
+    // so the distance changes at most by the sum of the fastest vertex speeds
+    real bound = speed(motion0) + speed(motion1);
+    real t = 0.0;
+    for (integer iteration = 0; iteration < MAX_ITERATIONS; ++iteration)
+    {
+      real gap = separation(motion0, motion1, t);
+      if (gap <= tolerance)
+      {
+        toi = t;
+        return true;
+      }
+      t = bound > 0.0 ? t + gap / bound : INFTY;
+      if (t > t_max)
+      {
+        toi = INFTY;
+        return false;
+      }
+    }
+    // The advancement did not converge, the time is only a lower bound
+    toi = t;
+    return false;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_sweep.cc
+///
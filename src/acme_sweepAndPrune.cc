@@ -0,0 +1,246 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_sweepAndPrune.cc
+///
+
+#include "acme_sweepAndPrune.hh"
+
+namespace acme
+{
+
+  /*\
+   |                                 _              _ ____                        
+   |   _____      _____  ___ _ __   / \   _ __   __| |  _ \ _ __ _   _ _ __   ___ 
+   |  / __\ \ /\ / / _ \/ _ \ '_ \ / _ \ | '_ \ / _` | |_) | '__| | | | '_ \ / _ \
+   |  \__ \\ V  V /  __/  __/ |_) / ___ \| | | | (_| |  __/| |  | |_| | | | |  __/
+   |  |___/ \_/\_/ \___|\___| .__/_/   \_\_| |_|\__,_|_|   |_|   \__,_|_| |_|\___|
+   |                        |_|                                                   
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  sweepAndPrune::~sweepAndPrune()
+  {
+    this->clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  sweepAndPrune::sweepAndPrune()
+  {
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::clear(void)
+  {
+    for (size_t k = 0; k < 3; ++k)
+      this->m_endpoints[k].clear();
+    this->m_boxes.clear();
+    this->m_bounds.clear();
+    this->m_previous.clear();
+    this->m_pairs.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  sweepAndPrune::isEmpty(void)
+      const
+  {
+    return this->m_boxes.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  sweepAndPrune::size(void)
+      const
+  {
+    return this->m_boxes.size();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::build(
+      aabb::vecptr const &boxes)
+  {
+    clear();
+
+    this->bounds(boxes);
+    integer size = boxes.size();
+    for (size_t k = 0; k < 3; ++k)
+    {
+      std::vector<endpoint> &endpoints = this->m_endpoints[k];
+      endpoints.resize(2 * size);
+      for (integer b = 0; b < size; ++b)
+      {
+        endpoints[2 * b].value = this->m_bounds[6 * b + k];
+        endpoints[2 * b].id = 2 * b;
+        endpoints[2 * b + 1].value = this->m_bounds[6 * b + 3 + k];
+        endpoints[2 * b + 1].id = 2 * b + 1;
+      }
+      std::sort(endpoints.begin(), endpoints.end(), less);
+    }
+
+    // Sweep along the first axis keeping the list of the open boxes
+    std::vector<integer> active;
+    std::vector<integer> position(size, -1);
+    std::vector<endpoint>::const_iterator it;
+    for (it = this->m_endpoints[0].begin(); it != this->m_endpoints[0].end(); ++it)
+    {
+      integer b = it->id >> 1;
+      if (it->id & 1)
+      {
+        // Remove the box swapping it with the last open box
+        integer last = active.back();
+        active[position[b]] = last;
+        position[last] = position[b];
+        active.pop_back();
+        continue;
+      }
+      std::vector<integer>::const_iterator open;
+      for (open = active.begin(); open != active.end(); ++open)
+        if (overlaps(this->m_bounds, b, *open))
+          this->m_pairs.insert(key(b, *open));
+      position[b] = active.size();
+      active.push_back(b);
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::update(
+      aabb::vecptr const &boxes,
+      vecpair &added,
+      vecpair &removed)
+  {
+    ACME_ASSERT(boxes.size() == this->m_boxes.size(),
+                "acme::sweepAndPrune::update(): the number of boxes does not match.")
+
+    // The overlaps are checked on the moved boxes, so the endpoints are all
+    // updated before sorting
+    this->m_previous.swap(this->m_bounds);
+    this->bounds(boxes);
+    for (size_t k = 0; k < 3; ++k)
+    {
+      std::vector<endpoint>::iterator it;
+      for (it = this->m_endpoints[k].begin(); it != this->m_endpoints[k].end(); ++it)
+        it->value = this->m_bounds[6 * (it->id >> 1) + 3 * (it->id & 1) + k];
+    }
+    for (size_t k = 0; k < 3; ++k)
+      this->sort(k, added, removed);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::pairs(
+      vecpair &pairs_out)
+      const
+  {
+    std::vector<uint64_t> keys(this->m_pairs.begin(), this->m_pairs.end());
+    std::sort(keys.begin(), keys.end());
+    pairs_out.reserve(pairs_out.size() + keys.size());
+    std::vector<uint64_t>::const_iterator it;
+    for (it = keys.begin(); it != keys.end(); ++it)
+      pairs_out.push_back(std::make_pair(integer(*it >> 32), integer(*it & 0xFFFFFFFF)));
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::bounds(
+      aabb::vecptr const &boxes)
+  {
+    this->m_boxes = boxes;
+    this->m_bounds.resize(6 * boxes.size());
+    for (size_t b = 0; b < boxes.size(); ++b)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        this->m_bounds[6 * b + k] = boxes[b]->min(k);
+        this->m_bounds[6 * b + 3 + k] = boxes[b]->max(k);
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  sweepAndPrune::sort(
+      size_t axis,
+      vecpair &added,
+      vecpair &removed)
+  {
+    // Every pair of endpoints that changed order is swapped exactly once, the
+    // swap gives the final order of the two endpoints along the axis
+    std::vector<endpoint> &endpoints = this->m_endpoints[axis];
+    for (size_t n = 1; n < endpoints.size(); ++n)
+    {
+      endpoint current = endpoints[n];
+      size_t m = n;
+      while (m > 0 && less(current, endpoints[m - 1]))
+      {
+        endpoint const &other = endpoints[m - 1];
+        integer a = current.id >> 1;
+        integer b = other.id >> 1;
+        if (a != b)
+        {
+          if (!(current.id & 1) && (other.id & 1))
+          {
+            // A minimum passed a maximum, the boxes may overlap now
+            if (overlaps(this->m_bounds, a, b) && this->m_pairs.insert(key(a, b)).second)
+              added.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+          }
+          else if ((current.id & 1) && !(other.id & 1))
+          {
+            // A maximum passed a minimum, the boxes are separated along the axis
+            // (only the boxes that overlapped at the previous step can be paired)
+            if (overlaps(this->m_previous, a, b) && this->m_pairs.erase(key(a, b)) > 0)
+              removed.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+          }
+        }
+        endpoints[m] = other;
+        --m;
+      }
+      endpoints[m] = current;
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_sweepAndPrune.cc
+///
@@ -0,0 +1,638 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+///
+/// file: acme_wideAABBtree.cc
+///
+
+#include "acme_wideAABBtree.hh"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace acme
+{
+
+  /*\
+   |            _     _         _        _    ____  ____  _                 
+   |  __      _(_) __| | ___   / \      / \  | __ )| __ )| |_ _ __ ___  ___ 
+   |  \ \ /\ / / |/ _` |/ _ \ / _ \    / _ \ |  _ \|  _ \| __| '__/ _ \/ _ \
+   |   \ V  V /| | (_| |  __// ___ \  / ___ \| |_) | |_) | |_| | |  __/  __/
+   |    \_/\_/ |_|\__,_|\___/_/   \_\/_/   \_\____/|____/ \__|_|  \___|\___|
+   |                                                                        
+  \*/
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  wideAABBtree::~wideAABBtree()
+  {
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  wideAABBtree::wideAABBtree()
+  {
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::clear(void)
+  {
+    this->m_nodes.clear();
+    this->m_boxes.clear();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  wideAABBtree::isEmpty(void)
+      const
+  {
+    return this->m_nodes.empty();
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::build(
+      AABBtree const &tree)
+  {
+    clear();
+
+    if (tree.isEmpty())
+      return;
+
+    this->m_boxes = tree.boxes();
+    AABBtree::vecnode const &nodes = tree.nodes();
+    if (nodes[0].count > 0)
+    {
+      // A single leaf is stored in the first child of the root
+      node root;
+      for (integer k = 0; k < WIDTH; ++k)
+      {
+        root.min_x[k] = root.min_y[k] = root.min_z[k] = INFTY;
+        root.max_x[k] = root.max_y[k] = root.max_z[k] = -INFTY;
+        root.child[k] = -1;
+        root.count[k] = 0;
+      }
+      root.min_x[0] = nodes[0].min[0];
+      root.min_y[0] = nodes[0].min[1];
+      root.min_z[0] = nodes[0].min[2];
+      root.max_x[0] = nodes[0].max[0];
+      root.max_y[0] = nodes[0].max[1];
+      root.max_z[0] = nodes[0].max[2];
+      root.child[0] = nodes[0].index;
+      root.count[0] = nodes[0].count;
+      root.mask = 1;
+      this->m_nodes.push_back(root);
+      return;
+    }
+    this->m_nodes.reserve(nodes.size() / 2 + 1);
+    this->collapse(nodes, 0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::build(
+      aabb::vecptr const &boxes,
+      AABBtree::method type)
+  {
+    AABBtree tree;
+    tree.setMethod(type);
+    tree.build(boxes);
+    this->build(tree);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  wideAABBtree::collapse(
+      AABBtree::vecnode const &nodes,
+      integer i)
+  {
+    integer w = this->m_nodes.size();
+    this->m_nodes.push_back(node());
+
+    // Open the inner child with the largest area until the node is full
+    integer children[WIDTH];
+    integer size = 0;
+    children[size++] = i + 1;
+    children[size++] = nodes[i].index;
+    while (size < WIDTH)
+    {
+      integer best = -1;
+      real best_area = -1.0;
+      for (integer k = 0; k < size; ++k)
+      {
+        AABBtree::node const &node_k = nodes[children[k]];
+        if (node_k.count == 0 && AABBtree::area(node_k) > best_area)
+        {
+          best = k;
+          best_area = AABBtree::area(node_k);
+        }
+      }
+      if (best < 0)
+        break;
+      integer c = children[best];
+      children[best] = c + 1;
+      children[size++] = nodes[c].index;
+    }
+
+    // The node array may grow in the recursion, so the node is filled by value
+    node wide;
+    wide.mask = 0;
+    for (integer k = 0; k < WIDTH; ++k)
+    {
+      if (k < size)
+      {
+        AABBtree::node const &node_k = nodes[children[k]];
+        wide.min_x[k] = node_k.min[0];
+        wide.min_y[k] = node_k.min[1];
+        wide.min_z[k] = node_k.min[2];
+        wide.max_x[k] = node_k.max[0];
+        wide.max_y[k] = node_k.max[1];
+        wide.max_z[k] = node_k.max[2];
+        wide.count[k] = node_k.count;
+        wide.child[k] = node_k.count > 0 ? node_k.index : this->collapse(nodes, children[k]);
+        wide.mask |= 1 << k;
+      }
+      else
+      {
+        // Unused children have empty boxes
+        wide.min_x[k] = wide.min_y[k] = wide.min_z[k] = INFTY;
+        wide.max_x[k] = wide.max_y[k] = wide.max_z[k] = -INFTY;
+        wide.child[k] = -1;
+        wide.count[k] = 0;
+      }
+    }
+    this->m_nodes[w] = wide;
+    return w;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  wideAABBtree::depth(void)
+      const
+  {
+    if (this->isEmpty())
+      return 0;
+    return this->depth(0);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  wideAABBtree::depth(
+      integer i)
+      const
+  {
+    node const &node_i = this->m_nodes[i];
+    integer child_depth = 0;
+    for (integer k = 0; k < WIDTH; ++k)
+      if ((node_i.mask >> k & 1) && node_i.count[k] == 0)
+        child_depth = std::max(child_depth, this->depth(node_i.child[k]));
+    return child_depth + 1;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  wideAABBtree::vecnode const &
+  wideAABBtree::nodes(void)
+      const
+  {
+    return this->m_nodes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  aabb::vecptr const &
+  wideAABBtree::boxes(void)
+      const
+  {
+    return this->m_boxes;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  wideAABBtree::overlapMask(
+      node const &node_in,
+      real const min[3],
+      real const max[3])
+  {
+#if defined(__AVX__)
+    __m256d x = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(node_in.min_x), _mm256_set1_pd(max[0]), _CMP_LE_OQ),
+                              _mm256_cmp_pd(_mm256_loadu_pd(node_in.max_x), _mm256_set1_pd(min[0]), _CMP_GE_OQ));
+    __m256d y = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(node_in.min_y), _mm256_set1_pd(max[1]), _CMP_LE_OQ),
+                              _mm256_cmp_pd(_mm256_loadu_pd(node_in.max_y), _mm256_set1_pd(min[1]), _CMP_GE_OQ));
+    __m256d z = _mm256_and_pd(_mm256_cmp_pd(_mm256_loadu_pd(node_in.min_z), _mm256_set1_pd(max[2]), _CMP_LE_OQ),
+                              _mm256_cmp_pd(_mm256_loadu_pd(node_in.max_z), _mm256_set1_pd(min[2]), _CMP_GE_OQ));
+    return _mm256_movemask_pd(_mm256_and_pd(x, _mm256_and_pd(y, z))) & node_in.mask;
+#elif defined(__SSE2__)
+    integer mask = 0;
+    for (integer k = 0; k < WIDTH; k += 2)
+    {
+      __m128d x = _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(node_in.min_x + k), _mm_set1_pd(max[0])),
+                             _mm_cmpge_pd(_mm_loadu_pd(node_in.max_x + k), _mm_set1_pd(min[0])));
+      __m128d y = _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(node_in.min_y + k), _mm_set1_pd(max[1])),
+                             _mm_cmpge_pd(_mm_loadu_pd(node_in.max_y + k), _mm_set1_pd(min[1])));
+      __m128d z = _mm_and_pd(_mm_cmple_pd(_mm_loadu_pd(node_in.min_z + k), _mm_set1_pd(max[2])),
+                             _mm_cmpge_pd(_mm_loadu_pd(node_in.max_z + k), _mm_set1_pd(min[2])));
+      mask |= _mm_movemask_pd(_mm_and_pd(x, _mm_and_pd(y, z))) << k;
+    }
+    return mask & node_in.mask;
+#else
+    integer mask = 0;
+    for (integer k = 0; k < WIDTH; ++k)
+      if (node_in.min_x[k] <= max[0] && node_in.max_x[k] >= min[0] &&
+          node_in.min_y[k] <= max[1] && node_in.max_y[k] >= min[1] &&
+          node_in.min_z[k] <= max[2] && node_in.max_z[k] >= min[2])
+        mask |= 1 << k;
+    return mask & node_in.mask;
+#endif
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  integer
+  wideAABBtree::rayMask(
+      node const &node_in,
+      real const origin[3],
+      real const inv_direction[3])
+  {
+    // A zero direction component gives an infinite inverse, the axis is then
+    // tested on the origin to avoid the 0 * inf products
+    real const *mins[3] = {node_in.min_x, node_in.min_y, node_in.min_z};
+    real const *maxs[3] = {node_in.max_x, node_in.max_y, node_in.max_z};
+#if defined(__AVX__)
+    __m256d t_min = _mm256_setzero_pd();
+    __m256d t_max = _mm256_set1_pd(INFTY);
+    __m256d inside = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    for (size_t k = 0; k < 3; ++k)
+    {
+      __m256d min = _mm256_loadu_pd(mins[k]);
+      __m256d max = _mm256_loadu_pd(maxs[k]);
+      __m256d o = _mm256_set1_pd(origin[k]);
+      if (std::isinf(inv_direction[k]))
+      {
+        inside = _mm256_and_pd(inside, _mm256_and_pd(_mm256_cmp_pd(min, o, _CMP_LE_OQ), _mm256_cmp_pd(max, o, _CMP_GE_OQ)));
+        continue;
+      }
+      __m256d inv = _mm256_set1_pd(inv_direction[k]);
+      __m256d t_0 = _mm256_mul_pd(_mm256_sub_pd(min, o), inv);
+      __m256d t_1 = _mm256_mul_pd(_mm256_sub_pd(max, o), inv);
+      t_min = _mm256_max_pd(t_min, _mm256_min_pd(t_0, t_1));
+      t_max = _mm256_min_pd(t_max, _mm256_max_pd(t_0, t_1));
+    }
+    inside = _mm256_and_pd(inside, _mm256_cmp_pd(t_min, t_max, _CMP_LE_OQ));
+    return _mm256_movemask_pd(inside) & node_in.mask;
+#elif defined(__SSE2__)
+    integer mask = 0;
+    for (integer l = 0; l < WIDTH; l += 2)
+    {
+      __m128d t_min = _mm_setzero_pd();
+      __m128d t_max = _mm_set1_pd(INFTY);
+      __m128d inside = _mm_castsi128_pd(_mm_set1_epi32(-1));
+      for (size_t k = 0; k < 3; ++k)
+      {
+        __m128d min = _mm_loadu_pd(mins[k] + l);
+        __m128d max = _mm_loadu_pd(maxs[k] + l);
+        __m128d o = _mm_set1_pd(origin[k]);
+        if (std::isinf(inv_direction[k]))
+        {
+          inside = _mm_and_pd(inside, _mm_and_pd(_mm_cmple_pd(min, o), _mm_cmpge_pd(max, o)));
+          continue;
+        }
+        __m128d inv = _mm_set1_pd(inv_direction[k]);
+        __m128d t_0 = _mm_mul_pd(_mm_sub_pd(min, o), inv);
+        __m128d t_1 = _mm_mul_pd(_mm_sub_pd(max, o), inv);
+        t_min = _mm_max_pd(t_min, _mm_min_pd(t_0, t_1));
+        t_max = _mm_min_pd(t_max, _mm_max_pd(t_0, t_1));
+      }
+      inside = _mm_and_pd(inside, _mm_cmple_pd(t_min, t_max));
+      mask |= _mm_movemask_pd(inside) << l;
+    }
+    return mask & node_in.mask;
+#else
+    integer mask = 0;
+    for (integer l = 0; l < WIDTH; ++l)
+    {
+      real t_min = 0.0;
+      real t_max = INFTY;
+      bool inside = true;
+      for (size_t k = 0; k < 3 && inside; ++k)
+      {
+        if (std::isinf(inv_direction[k]))
+        {
+          inside = mins[k][l] <= origin[k] && maxs[k][l] >= origin[k];
+          continue;
+        }
+        real t_0 = (mins[k][l] - origin[k]) * inv_direction[k];
+        real t_1 = (maxs[k][l] - origin[k]) * inv_direction[k];
+        t_min = std::max(t_min, std::min(t_0, t_1));
+        t_max = std::min(t_max, std::max(t_0, t_1));
+      }
+      if (inside && t_min <= t_max)
+        mask |= 1 << l;
+    }
+    return mask & node_in.mask;
+#endif
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  bool
+  wideAABBtree::rayHit(
+      aabb const &box_in,
+      real const origin[3],
+      real const inv_direction[3])
+  {
+    real t_min = 0.0;
+    real t_max = INFTY;
+    for (size_t k = 0; k < 3; ++k)
+    {
+      if (std::isinf(inv_direction[k]))
+      {
+        if (box_in.min(k) > origin[k] || box_in.max(k) < origin[k])
+          return false;
+        continue;
+      }
+      real t_0 = (box_in.min(k) - origin[k]) * inv_direction[k];
+      real t_1 = (box_in.max(k) - origin[k]) * inv_direction[k];
+      t_min = std::max(t_min, std::min(t_0, t_1));
+      t_max = std::min(t_max, std::max(t_0, t_1));
+    }
+    return t_min <= t_max;
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::intersection(
+      aabb const &box,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    real min[3] = {box.min(0), box.min(1), box.min(2)};
+    real max[3] = {box.max(0), box.max(1), box.max(2)};
+    this->boxIntersection(min, max, 0, candidate_list);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::intersection(
+      ray const &ray_in,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    if (this->isEmpty())
+      return;
+    real origin[3];
+    real inv_direction[3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      origin[k] = ray_in.origin()[k];
+      inv_direction[k] = 1.0 / ray_in.direction()[k];
+    }
+    this->rayIntersection(origin, inv_direction, 0, candidate_list);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::intersection(
+      wideAABBtree const &tree,
+      aabb::vecpairptr &intersection_list)
+      const
+  {
+    if (this->isEmpty() || tree.isEmpty())
+      return;
+    this->intersection(tree, 0, 0, intersection_list);
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::boxIntersection(
+      real const min[3],
+      real const max[3],
+      integer i,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      node const &node_i = this->m_nodes[stack[--top]];
+      integer mask = overlapMask(node_i, min, max);
+      for (integer k = 0; mask != 0; ++k, mask >>= 1)
+      {
+        if (!(mask & 1))
+          continue;
+        if (node_i.count[k] == 1)
+        {
+          candidate_list.push_back(this->m_boxes[node_i.child[k]]);
+        }
+        else if (node_i.count[k] > 1)
+        {
+          for (integer b = node_i.child[k]; b < node_i.child[k] + node_i.count[k]; ++b)
+          {
+            aabb const &box = *this->m_boxes[b];
+            if (box.min(0) <= max[0] && box.max(0) >= min[0] &&
+                box.min(1) <= max[1] && box.max(1) >= min[1] &&
+                box.min(2) <= max[2] && box.max(2) >= min[2])
+              candidate_list.push_back(this->m_boxes[b]);
+          }
+        }
+        else if (top == STACK_SIZE)
+        {
+          // The local stack is full, visit the child on a new one
+          this->boxIntersection(min, max, node_i.child[k], candidate_list);
+        }
+        else
+        {
+          stack[top++] = node_i.child[k];
+        }
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::rayIntersection(
+      real const origin[3],
+      real const inv_direction[3],
+      integer i,
+      aabb::vecptr &candidate_list)
+      const
+  {
+    integer stack[STACK_SIZE];
+    integer top = 0;
+    stack[top++] = i;
+    while (top > 0)
+    {
+      node const &node_i = this->m_nodes[stack[--top]];
+      integer mask = rayMask(node_i, origin, inv_direction);
+      for (integer k = 0; mask != 0; ++k, mask >>= 1)
+      {
+        if (!(mask & 1))
+          continue;
+        if (node_i.count[k] == 1)
+        {
+          candidate_list.push_back(this->m_boxes[node_i.child[k]]);
+        }
+        else if (node_i.count[k] > 1)
+        {
+          for (integer b = node_i.child[k]; b < node_i.child[k] + node_i.count[k]; ++b)
+          {
+            if (rayHit(*this->m_boxes[b], origin, inv_direction))
+              candidate_list.push_back(this->m_boxes[b]);
+          }
+        }
+        else if (top == STACK_SIZE)
+        {
+          // The local stack is full, visit the child on a new one
+          this->rayIntersection(origin, inv_direction, node_i.child[k], candidate_list);
+        }
+        else
+        {
+          stack[top++] = node_i.child[k];
+        }
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  void
+  wideAABBtree::intersection(
+      wideAABBtree const &tree,
+      integer i,
+      integer j,
+      aabb::vecpairptr &intersection_list)
+      const
+  {
+    integer stack_i[STACK_SIZE];
+    integer stack_j[STACK_SIZE];
+    integer top = 0;
+    stack_i[top] = i;
+    stack_j[top] = j;
+    ++top;
+    aabb::vecptr candidate_list;
+    while (top > 0)
+    {
+      --top;
+      node const &node_i = this->m_nodes[stack_i[top]];
+      node const &node_j = tree.m_nodes[stack_j[top]];
+
+      // Test every child of the first node against all the children of the second one
+      for (integer a = 0; a < WIDTH; ++a)
+      {
+        if (!(node_i.mask >> a & 1))
+          continue;
+        real min[3] = {node_i.min_x[a], node_i.min_y[a], node_i.min_z[a]};
+        real max[3] = {node_i.max_x[a], node_i.max_y[a], node_i.max_z[a]};
+        integer mask = overlapMask(node_j, min, max);
+        for (integer b = 0; mask != 0; ++b, mask >>= 1)
+        {
+          if (!(mask & 1))
+            continue;
+          if (node_i.count[a] == 0 && node_j.count[b] == 0)
+          {
+            if (top == STACK_SIZE)
+            {
+              // The local stack is full, visit the pair on a new one
+              this->intersection(tree, node_i.child[a], node_j.child[b], intersection_list);
+            }
+            else
+            {
+              stack_i[top] = node_i.child[a];
+              stack_j[top] = node_j.child[b];
+              ++top;
+            }
+          }
+          else if (node_i.count[a] > 0)
+          {
+            // Query the boxes of the leaf against the second subtree
+            for (integer p = node_i.child[a]; p < node_i.child[a] + node_i.count[a]; ++p)
+            {
+              aabb const &box = *this->m_boxes[p];
+              real box_min[3] = {box.min(0), box.min(1), box.min(2)};
+              real box_max[3] = {box.max(0), box.max(1), box.max(2)};
+              candidate_list.clear();
+              if (node_j.count[b] > 0)
+              {
+                for (integer q = node_j.child[b]; q < node_j.child[b] + node_j.count[b]; ++q)
+                  if (box.intersects(*tree.m_boxes[q]))
+                    candidate_list.push_back(tree.m_boxes[q]);
+              }
+              else
+              {
+                tree.boxIntersection(box_min, box_max, node_j.child[b], candidate_list);
+              }
+              for (size_t q = 0; q < candidate_list.size(); ++q)
+                intersection_list.push_back(aabb::pairptr(this->m_boxes[p], candidate_list[q]));
+            }
+          }
+          else
+          {
+            // Query the boxes of the leaf against the first subtree
+            for (integer q = node_j.child[b]; q < node_j.child[b] + node_j.count[b]; ++q)
+            {
+              aabb const &box = *tree.m_boxes[q];
+              real box_min[3] = {box.min(0), box.min(1), box.min(2)};
+              real box_max[3] = {box.max(0), box.max(1), box.max(2)};
+              candidate_list.clear();
+              this->boxIntersection(box_min, box_max, node_i.child[a], candidate_list);
+              for (size_t p = 0; p < candidate_list.size(); ++p)
+                intersection_list.push_back(aabb::pairptr(candidate_list[p], tree.m_boxes[q]));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} // namespace acme
+
+///
+/// eof: acme_wideAABBtree.cc
+///
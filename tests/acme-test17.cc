@@ -0,0 +1,129 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 17 - AABB TREE BUILDING METHODS
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_math.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 17 - AABB TREE BUILDING METHODS" << std::endl
+      << std::endl;
+
+  // Initialize a road-like mesh with a dense patch near the origin
+  aabb::vecptr vecBox;
+  integer n = 60;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = i < n / 2 ? 0.1 * i : 3.0 + 2.0 * (i - n / 2);
+      real y = j < n / 2 ? 0.1 * j : 3.0 + 2.0 * (j - n / 2);
+      real dx = i < n / 2 ? 0.1 : 2.0;
+      real dy = j < n / 2 ? 0.1 : 2.0;
+      point V[3];
+      V[0] = point(x, y, 0.0);
+      V[1] = point(x + dx, y, 0.01 * x);
+      V[2] = point(x, y + dy, 0.01 * y);
+      aabb Box;
+      Box.clamp(V);
+      Box.id() = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(Box)));
+    }
+  }
+
+  // Initialize query boxes
+  aabb::vecptr vecBoxQuery;
+  vecBoxQuery.push_back(aabb::ptr(new aabb(1.0, 1.0, -1.0, 1.5, 1.5, 1.0, 0, 0)));
+  vecBoxQuery.push_back(aabb::ptr(new aabb(20.0, 20.0, -1.0, 30.0, 22.0, 1.0, 1, 0)));
+  AABBtree treeQuery;
+  treeQuery.build(vecBoxQuery);
+
+  // Build the trees
+  AABBtree treeMidpoint;
+  treeMidpoint.build(vecBox);
+
+  AABBtree treeSAH;
+  treeSAH.setMethod(AABBtree::SAH, 16, 1.0, 1.0);
+  treeSAH.build(vecBox);
+
+  AABBtree treeLBVH;
+  treeLBVH.setMethod(AABBtree::LBVH);
+  treeLBVH.build(vecBox);
+
+  // Expensive traversals make the cost model keep small ranges as leaves
+  AABBtree treeLeaves;
+  treeLeaves.setMethod(AABBtree::SAH, 16, 4.0, 1.0);
+  treeLeaves.setLeafSize(8);
+  treeLeaves.build(vecBox);
+
+  // Perform intersections
+  aabb::vecpairptr intMidpoint;
+  aabb::vecpairptr intSAH;
+  aabb::vecpairptr intLBVH;
+  treeMidpoint.intersection(treeQuery, intMidpoint);
+  treeSAH.intersection(treeQuery, intSAH);
+  treeLBVH.intersection(treeQuery, intLBVH);
+  aabb::vecpairptr intLeaves;
+  treeLeaves.intersection(treeQuery, intLeaves);
+
+  std::cout
+      << "Boxes                    = " << vecBox.size() << std::endl
+      << "Midpoint SAH cost        = " << treeMidpoint.costSAH() << std::endl
+      << "SAH SAH cost             = " << treeSAH.costSAH() << std::endl
+      << "LBVH SAH cost            = " << treeLBVH.costSAH() << std::endl
+      << "SAH nodes                = " << treeSAH.nodes().size() << std::endl
+      << "SAH leaves nodes         = " << treeLeaves.nodes().size() << std::endl
+      << "Midpoint intersections   = " << intMidpoint.size() << std::endl
+      << "SAH intersections        = " << intSAH.size() << std::endl
+      << "LBVH intersections       = " << intLBVH.size() << std::endl
+      << "SAH leaves intersections = " << intLeaves.size() << std::endl
+      << std::endl;
+
+  if (intMidpoint.size() != intSAH.size() || intMidpoint.size() != intLBVH.size() ||
+      intMidpoint.size() != intLeaves.size())
+    std::cout << "Check the building methods!" << std::endl;
+
+  std::cout
+      << "TEST 17: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 18 - DYNAMIC AABB TREE
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_dynamicAABBtree.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 18 - DYNAMIC AABB TREE" << std::endl
+      << std::endl;
+
+  // Initialize a static road made of boxes along the x axis
+  aabb::vecptr vecBox;
+  for (integer i = 0; i < 100; ++i)
+    vecBox.push_back(aabb::ptr(new aabb(i, -2.0, -0.1, i + 1.0, 2.0, 0.0, i, 0)));
+  AABBtree tree;
+  tree.build(vecBox);
+
+  // Insert vehicles in the dynamic tree
+  dynamicAABBtree dynamicTree(0.5);
+  std::vector<integer> vehicles;
+  for (integer i = 0; i < 10; ++i)
+    vehicles.push_back(dynamicTree.insert(aabb::ptr(new aabb(10.0 * i, -1.0, 1.0, 10.0 * i + 2.0, 1.0, 2.0, i, 0))));
+
+  aabb::vecpairptr intBoxPair;
+  dynamicTree.intersection(tree, intBoxPair);
+  std::cout
+      << "Vehicles                 = " << dynamicTree.size() << std::endl
+      << "Tree height              = " << dynamicTree.height() << std::endl
+      << "Vehicles on the road     = " << intBoxPair.size() << std::endl;
+
+  // Small motions are absorbed by the fattened boxes
+  integer updates = 0;
+  for (integer i = 0; i < 10; ++i)
+    updates += dynamicTree.move(vehicles[i], aabb::ptr(new aabb(10.0 * i + 0.1, -1.0, 0.9, 10.0 * i + 2.1, 1.0, 1.9, i, 0)));
+  std::cout
+      << "Updates after 0.1 motion = " << updates << std::endl;
+
+  // Land the vehicles on the road
+  updates = 0;
+  for (integer i = 0; i < 10; ++i)
+    updates += dynamicTree.move(vehicles[i], aabb::ptr(new aabb(10.0 * i, -1.0, -0.05, 10.0 * i + 2.0, 1.0, 0.95, i, 0)));
+  intBoxPair.clear();
+  dynamicTree.intersection(tree, intBoxPair);
+  std::cout
+      << "Updates after landing    = " << updates << std::endl
+      << "Vehicle/road candidates  = " << intBoxPair.size() << std::endl;
+
+  // Remove half of the vehicles
+  for (integer i = 0; i < 10; i += 2)
+    dynamicTree.remove(vehicles[i]);
+  intBoxPair.clear();
+  dynamicTree.intersection(tree, intBoxPair);
+  std::cout
+      << "Vehicles after removal   = " << dynamicTree.size() << std::endl
+      << "Vehicle/road candidates  = " << intBoxPair.size() << std::endl
+      << std::endl
+      << "TEST 18: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 19 - CLOSEST ENTITY QUERY
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_collection.hh"
+#include "acme_distance.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 19 - CLOSEST ENTITY QUERY" << std::endl
+      << std::endl;
+
+  // Initialize a terrain grid of 2 x 50 x 50 triangles
+  collection terrain;
+  for (integer i = 0; i < 50; ++i)
+  {
+    for (integer j = 0; j < 50; ++j)
+    {
+      point P00(i, j, 0.0), P10(i + 1.0, j, 0.0), P01(i, j + 1.0, 0.0), P11(i + 1.0, j + 1.0, 0.1);
+      terrain.push_back(entity::ptr(new triangle(P00, P10, P11)));
+      terrain.push_back(entity::ptr(new triangle(P00, P11, P01)));
+    }
+  }
+  terrain.buildAABBtree();
+
+  // Find the closest triangle to a point above the terrain
+  point query(10.3, 20.6, 1.0);
+  entity::ptr closestEntity;
+  real closestDistance;
+  terrain.closest(query, closestEntity, closestDistance);
+
+  // Check against a linear scan
+  real scanDistance = INFTY;
+  for (integer i = 0; i < terrain.size(); ++i)
+    scanDistance = std::min(scanDistance, distance(query, terrain[i].get()));
+
+  // Find the 5 nearest triangles
+  collection nearestEntities;
+  std::vector<real> nearestDistances;
+  terrain.nearest(query, 5, nearestEntities, nearestDistances);
+
+  std::cout
+      << "Query point      = " << query << std::endl
+      << "Closest entity   = " << *dynamic_cast<triangle *>(closestEntity.get()) << std::endl
+      << "Closest distance = " << closestDistance << std::endl
+      << "Scan distance    = " << scanDistance << std::endl
+      << "Nearest distances:";
+  for (size_t i = 0; i < nearestDistances.size(); ++i)
+    std::cout << " " << nearestDistances[i];
+  std::cout
+      << std::endl
+      << std::endl
+      << "TEST 19: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
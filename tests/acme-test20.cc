@@ -0,0 +1,148 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 20 - WIDE AABB TREE QUERIES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_ray.hh"
+#include "acme_utils.hh"
+#include "acme_wideAABBtree.hh"
+
+using namespace acme;
+
+// Sorted identifiers of a candidate list
+std::vector<integer>
+candidateIds(aabb::vecptr const &candidates)
+{
+  std::vector<integer> ids;
+  for (size_t i = 0; i < candidates.size(); ++i)
+    ids.push_back(candidates[i]->id());
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 20 - WIDE AABB TREE QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize a grid of small boxes with scattered sizes and heights
+  aabb::vecptr vecBox;
+  integer n = 40;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = i + 0.3 * std::sin(1.7 * j);
+      real y = j + 0.3 * std::cos(2.3 * i);
+      real z = 0.5 * std::sin(0.4 * i + 0.7 * j);
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, id, 0)));
+    }
+  }
+
+  // Build the binary tree with leaves of more boxes and the wide tree on top of it
+  AABBtree treeBinary;
+  treeBinary.setLeafSize(4);
+  treeBinary.build(vecBox);
+  wideAABBtree treeWide;
+  treeWide.build(treeBinary);
+
+  // Compare box queries
+  integer boxQueries = 0, boxCandidates = 0, boxMismatches = 0;
+  for (integer k = 0; k < 50; ++k)
+  {
+    real x = 20.0 + 18.0 * std::sin(0.9 * k);
+    real y = 20.0 + 18.0 * std::cos(1.3 * k);
+    real d = 0.5 + 2.0 * (k % 5);
+    aabb box(x - d, y - d, -0.1, x + d, y + d, 0.1, k, 0);
+    aabb::vecptr candidatesBinary, candidatesWide;
+    treeBinary.intersection(box, candidatesBinary);
+    treeWide.intersection(box, candidatesWide);
+    ++boxQueries;
+    boxCandidates += candidatesWide.size();
+    if (candidateIds(candidatesBinary) != candidateIds(candidatesWide))
+      ++boxMismatches;
+  }
+
+  // Compare ray queries, also along the axes (zero direction components)
+  integer rayQueries = 0, rayCandidates = 0, rayMismatches = 0;
+  for (integer k = 0; k < 50; ++k)
+  {
+    real angle = 0.13 * k;
+    real x = 20.0 + 18.0 * std::sin(0.7 * k);
+    real y = 20.0 + 18.0 * std::cos(1.1 * k);
+    ray rays[3] = {
+        ray(-1.0, y, 0.0, std::cos(angle), 0.2 * std::sin(angle), 0.01 * (k % 3 - 1)),
+        ray(x, -1.0, 0.2, 0.0, 1.0, 0.0),
+        ray(x, y, 5.0, 0.0, 0.0, -1.0)};
+    for (integer r = 0; r < 3; ++r)
+    {
+      aabb::vecptr candidatesBinary, candidatesWide;
+      treeBinary.intersection(rays[r], candidatesBinary);
+      treeWide.intersection(rays[r], candidatesWide);
+      ++rayQueries;
+      rayCandidates += candidatesWide.size();
+      if (candidateIds(candidatesBinary) != candidateIds(candidatesWide))
+        ++rayMismatches;
+    }
+  }
+
+  std::cout
+      << "Boxes              = " << vecBox.size() << std::endl
+      << "Binary tree nodes  = " << treeBinary.nodes().size() << std::endl
+      << "Wide tree nodes    = " << treeWide.nodes().size() << std::endl
+      << "Box queries        = " << boxQueries << std::endl
+      << "Box candidates     = " << boxCandidates << std::endl
+      << "Box mismatches     = " << boxMismatches << std::endl
+      << "Ray queries        = " << rayQueries << std::endl
+      << "Ray candidates     = " << rayCandidates << std::endl
+      << "Ray mismatches     = " << rayMismatches << std::endl
+      << std::endl;
+
+  if (boxMismatches != 0 || rayMismatches != 0)
+  {
+    std::cout << "Check the wide AABB tree queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 20: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
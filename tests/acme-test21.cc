@@ -0,0 +1,155 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 21 - QUANTIZED AABB TREE QUERIES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_quantizedAABBtree.hh"
+#include "acme_ray.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifiers of a candidate list
+std::vector<integer>
+candidateIds(aabb::vecptr const &candidates)
+{
+  std::vector<integer> ids;
+  for (size_t i = 0; i < candidates.size(); ++i)
+    ids.push_back(candidates[i]->id());
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 21 - QUANTIZED AABB TREE QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize a grid of small boxes with scattered sizes, far from the origin
+  // so that the quantization step is not a power of two of the coordinates
+  aabb::vecptr vecBox;
+  integer n = 40;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = 1000.0 + i + 0.3 * std::sin(1.7 * j);
+      real y = -500.0 + j + 0.3 * std::cos(2.3 * i);
+      real z = 0.5 * std::sin(0.4 * i + 0.7 * j);
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, id, 0)));
+    }
+  }
+
+  // Build the binary tree and its 16-bit and 8-bit quantized copies
+  AABBtree treeBinary;
+  treeBinary.setLeafSize(2);
+  treeBinary.build(vecBox);
+  quantizedAABBtree tree16(16);
+  tree16.build(treeBinary);
+  quantizedAABBtree tree8(8);
+  tree8.build(treeBinary);
+
+  // Compare box queries
+  integer boxQueries = 0, boxCandidates = 0, boxMismatches = 0;
+  for (integer k = 0; k < 50; ++k)
+  {
+    real x = 1020.0 + 18.0 * std::sin(0.9 * k);
+    real y = -480.0 + 18.0 * std::cos(1.3 * k);
+    real d = 0.5 + 2.0 * (k % 5);
+    aabb box(x - d, y - d, -0.1, x + d, y + d, 0.1, k, 0);
+    aabb::vecptr candidatesBinary, candidates16, candidates8;
+    treeBinary.intersection(box, candidatesBinary);
+    tree16.intersection(box, candidates16);
+    tree8.intersection(box, candidates8);
+    ++boxQueries;
+    boxCandidates += candidatesBinary.size();
+    std::vector<integer> ids = candidateIds(candidatesBinary);
+    if (ids != candidateIds(candidates16) || ids != candidateIds(candidates8))
+      ++boxMismatches;
+  }
+
+  // Compare ray queries, also along the axes (zero direction components)
+  integer rayQueries = 0, rayCandidates = 0, rayMismatches = 0;
+  for (integer k = 0; k < 50; ++k)
+  {
+    real angle = 0.13 * k;
+    real x = 1020.0 + 18.0 * std::sin(0.7 * k);
+    real y = -480.0 + 18.0 * std::cos(1.1 * k);
+    ray rays[3] = {
+        ray(999.0, y, 0.0, std::cos(angle), 0.2 * std::sin(angle), 0.01 * (k % 3 - 1)),
+        ray(x, -501.0, 0.2, 0.0, 1.0, 0.0),
+        ray(x, y, 5.0, 0.0, 0.0, -1.0)};
+    for (integer r = 0; r < 3; ++r)
+    {
+      aabb::vecptr candidatesBinary, candidates16, candidates8;
+      treeBinary.intersection(rays[r], candidatesBinary);
+      tree16.intersection(rays[r], candidates16);
+      tree8.intersection(rays[r], candidates8);
+      ++rayQueries;
+      rayCandidates += candidatesBinary.size();
+      std::vector<integer> ids = candidateIds(candidatesBinary);
+      if (ids != candidateIds(candidates16) || ids != candidateIds(candidates8))
+        ++rayMismatches;
+    }
+  }
+
+  std::cout
+      << "Boxes              = " << vecBox.size() << std::endl
+      << "16-bit tree memory = " << tree16.memory() << " bytes" << std::endl
+      << "8-bit tree memory  = " << tree8.memory() << " bytes" << std::endl
+      << "Box queries        = " << boxQueries << std::endl
+      << "Box candidates     = " << boxCandidates << std::endl
+      << "Box mismatches     = " << boxMismatches << std::endl
+      << "Ray queries        = " << rayQueries << std::endl
+      << "Ray candidates     = " << rayCandidates << std::endl
+      << "Ray mismatches     = " << rayMismatches << std::endl
+      << std::endl;
+
+  if (boxMismatches != 0 || rayMismatches != 0)
+  {
+    std::cout << "Check the quantized AABB tree queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 21: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
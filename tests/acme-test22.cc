@@ -0,0 +1,150 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 22 - HASH GRID QUERIES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_aabb.hh"
+#include "acme_hashGrid.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifier pairs of an intersection list
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs, bool sort_pair)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+  {
+    integer a = pairs[i].first->id(), b = pairs[i].second->id();
+    if (sort_pair && b < a)
+      std::swap(a, b);
+    ids.push_back(std::make_pair(a, b));
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 22 - HASH GRID QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize two sets of small boxes with scattered sizes
+  aabb::vecptr vecBox0, vecBox1;
+  for (integer i = 0; i < 400; ++i)
+  {
+    real x = 10.0 * std::sin(1.3 * i), y = 10.0 * std::cos(0.7 * i), z = std::sin(2.1 * i);
+    real d = 0.3 + 0.25 * std::sin(3.7 * i);
+    vecBox0.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, i, 0)));
+    x = 10.0 * std::cos(1.9 * i), y = 10.0 * std::sin(0.3 * i), z = std::cos(1.1 * i);
+    vecBox1.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, 1000 + i, 0)));
+  }
+
+  // Add the boxes that do not fit the grid: huge, far, spanning more cells
+  // than the keys can tell apart, infinite and not-a-number
+  vecBox0.push_back(aabb::ptr(new aabb(-1.0e12, -1.0e12, -1.0e12, 1.0e12, 1.0e12, 1.0e12, 400, 0)));
+  vecBox0.push_back(aabb::ptr(new aabb(1.0e20, 0.0, 0.0, 1.0e20 + 1.0, 1.0, 1.0, 401, 0)));
+  vecBox0.push_back(aabb::ptr(new aabb(-3.0e6, 0.0, 0.0, 3.0e6, 0.1, 0.1, 402, 0)));
+  vecBox1.push_back(aabb::ptr(new aabb(-INFTY, 2.0, -INFTY, INFTY, 2.5, INFTY, 1400, 0)));
+  vecBox1.push_back(aabb::ptr(new aabb(QUIET_NAN, 0.0, 0.0, 1.0, 1.0, 1.0, 1401, 0)));
+
+  hashGrid grid0(1.0), grid1(1.0);
+  grid0.build(vecBox0);
+  grid1.build(vecBox1);
+
+  // Self intersection against brute force
+  aabb::vecpairptr selfGrid, selfBrute;
+  grid0.selfIntersection(selfGrid);
+  for (size_t i = 0; i < vecBox0.size(); ++i)
+    for (size_t j = i + 1; j < vecBox0.size(); ++j)
+      if (vecBox0[i]->intersects(*vecBox0[j]))
+        selfBrute.push_back(aabb::pairptr(vecBox0[i], vecBox0[j]));
+
+  // Intersection of the two grids against brute force
+  aabb::vecpairptr pairGrid, pairSwap, pairBrute;
+  grid0.intersection(grid1, pairGrid);
+  grid1.intersection(grid0, pairSwap, true);
+  for (size_t i = 0; i < vecBox0.size(); ++i)
+    for (size_t j = 0; j < vecBox1.size(); ++j)
+      if (vecBox0[i]->intersects(*vecBox1[j]))
+        pairBrute.push_back(aabb::pairptr(vecBox0[i], vecBox1[j]));
+
+  // Box queries against brute force, also with a query box out of the grid
+  integer queryMismatches = 0;
+  for (integer k = 0; k < 20; ++k)
+  {
+    real x = 10.0 * std::sin(0.9 * k), y = 10.0 * std::cos(1.7 * k);
+    real d = k < 19 ? 0.5 + 0.5 * (k % 4) : 1.0e9;
+    aabb box(x - d, y - d, -d, x + d, y + d, d, k, 0);
+    aabb::vecptr candidates;
+    grid1.intersection(box, candidates);
+    std::vector<integer> idsGrid, idsBrute;
+    for (size_t i = 0; i < candidates.size(); ++i)
+      idsGrid.push_back(candidates[i]->id());
+    for (size_t i = 0; i < vecBox1.size(); ++i)
+      if (vecBox1[i]->intersects(box))
+        idsBrute.push_back(vecBox1[i]->id());
+    std::sort(idsGrid.begin(), idsGrid.end());
+    if (idsGrid != idsBrute)
+      ++queryMismatches;
+  }
+
+  bool selfMatch = pairIds(selfGrid, true) == pairIds(selfBrute, true);
+  bool pairMatch = pairIds(pairGrid, false) == pairIds(pairBrute, false) &&
+                   pairIds(pairSwap, false) == pairIds(pairBrute, false);
+
+  std::cout
+      << "Grid 0 boxes            = " << vecBox0.size() << std::endl
+      << "Grid 1 boxes            = " << vecBox1.size() << std::endl
+      << "Grid 0 cells            = " << grid0.cells() << std::endl
+      << "Self intersections      = " << selfGrid.size() << " (brute force " << selfBrute.size() << ")" << std::endl
+      << "Grid intersections      = " << pairGrid.size() << " (brute force " << pairBrute.size() << ")" << std::endl
+      << "Swapped intersections   = " << pairSwap.size() << std::endl
+      << "Box query mismatches    = " << queryMismatches << std::endl
+      << std::endl;
+
+  if (!selfMatch || !pairMatch || queryMismatches != 0)
+  {
+    std::cout << "Check the hash grid queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 22: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,147 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 23 - SWEEP AND PRUNE UPDATES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "acme.hh"
+#include "acme_aabb.hh"
+#include "acme_sweepAndPrune.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+typedef std::set<std::pair<integer, integer>> setpair;
+
+// Boxes of the particles at a given step
+aabb::vecptr
+particleBoxes(integer n, integer step)
+{
+  aabb::vecptr boxes;
+  for (integer i = 0; i < n; ++i)
+  {
+    real t = 0.05 * step;
+    real x = 8.0 * std::sin(1.3 * i + 0.7 * t) + 0.3 * std::sin(5.1 * i * t);
+    real y = 8.0 * std::cos(0.9 * i + 1.1 * t);
+    real z = 2.0 * std::sin(0.4 * i - 0.5 * t);
+    // Some boxes share coordinates, so the endpoints tie along an axis
+    if (i % 10 == 0)
+      x = std::floor(x);
+    real d = 0.4 + 0.2 * std::sin(2.9 * i);
+    boxes.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, i, 0)));
+  }
+  return boxes;
+}
+
+// Pairs of overlapping boxes by brute force
+setpair
+brutePairs(aabb::vecptr const &boxes)
+{
+  setpair pairs;
+  for (size_t i = 0; i < boxes.size(); ++i)
+    for (size_t j = i + 1; j < boxes.size(); ++j)
+      if (boxes[i]->intersects(*boxes[j]))
+        pairs.insert(std::make_pair(integer(i), integer(j)));
+  return pairs;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 23 - SWEEP AND PRUNE UPDATES" << std::endl
+      << std::endl;
+
+  integer n = 300;
+  integer steps = 100;
+  sweepAndPrune sap;
+  aabb::vecptr boxes = particleBoxes(n, 0);
+  sap.build(boxes);
+  setpair tracked = brutePairs(boxes);
+
+  // Move the boxes, the tracked pairs updated with the reported changes must
+  // match the brute force pairs at every step
+  integer totalAdded = 0, totalRemoved = 0, mismatches = 0;
+  for (integer step = 1; step <= steps; ++step)
+  {
+    boxes = particleBoxes(n, step);
+    sweepAndPrune::vecpair added, removed;
+    sap.update(boxes, added, removed);
+    for (size_t p = 0; p < removed.size(); ++p)
+    {
+      std::pair<integer, integer> pair(std::min(removed[p].first, removed[p].second),
+                                       std::max(removed[p].first, removed[p].second));
+      if (tracked.erase(pair) != 1)
+        ++mismatches;
+    }
+    for (size_t p = 0; p < added.size(); ++p)
+    {
+      std::pair<integer, integer> pair(std::min(added[p].first, added[p].second),
+                                       std::max(added[p].first, added[p].second));
+      if (!tracked.insert(pair).second)
+        ++mismatches;
+    }
+    totalAdded += added.size();
+    totalRemoved += removed.size();
+
+    setpair brute = brutePairs(boxes);
+    sweepAndPrune::vecpair all;
+    sap.pairs(all);
+    setpair listed;
+    for (size_t p = 0; p < all.size(); ++p)
+      listed.insert(std::make_pair(std::min(all[p].first, all[p].second),
+                                   std::max(all[p].first, all[p].second)));
+    if (tracked != brute || listed != brute || all.size() != brute.size())
+      ++mismatches;
+  }
+
+  std::cout
+      << "Boxes               = " << n << std::endl
+      << "Steps               = " << steps << std::endl
+      << "Final pairs         = " << tracked.size() << std::endl
+      << "Added pairs         = " << totalAdded << std::endl
+      << "Removed pairs       = " << totalRemoved << std::endl
+      << "Mismatches          = " << mismatches << std::endl
+      << std::endl;
+
+  if (mismatches != 0)
+  {
+    std::cout << "Check the sweep-and-prune updates!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 23: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 24 - TIME OF IMPACT
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_ball.hh"
+#include "acme_collection.hh"
+#include "acme_point.hh"
+#include "acme_segment.hh"
+#include "acme_sweep.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 24 - TIME OF IMPACT" << std::endl
+      << std::endl;
+
+  affine identity(translate(0.0, 0.0, 0.0));
+  real toleranceTime = 1.0e-5;
+  integer failures = 0;
+
+  // Segment crossing a thin triangle: x(t) = 0.99 - 2t, impact at t = 0.495
+  triangle thinTriangle(point(0.0, -1.0, 0.0), point(0.0, 1.0, 0.0), point(0.0, 0.0, 0.01));
+  segment crossingSegment(point(0.99, 0.0, -1.0), point(0.99, 0.0, 1.0));
+  real toiSegment = QUIET_NAN;
+  bool hitSegment = timeOfImpact(&crossingSegment, identity, affine(translate(-2.0, 0.0, 0.0)),
+                                 &thinTriangle, identity, identity, toiSegment);
+  if (!hitSegment || std::abs(toiSegment - 0.495) > toleranceTime)
+    ++failures;
+
+  // Ball falling on a triangle: z(t) = 1 - 2t = 0.25, impact at t = 0.375
+  triangle floorTriangle(point(-5.0, -5.0, 0.0), point(5.0, -5.0, 0.0), point(0.0, 5.0, 0.0));
+  ball fallingBall(0.25, point(0.0, 0.0, 1.0));
+  real toiTriangle = QUIET_NAN;
+  bool hitTriangle = timeOfImpact(&fallingBall, identity, affine(translate(0.0, 0.0, -2.0)),
+                                  &floorTriangle, identity, identity, toiTriangle);
+  if (!hitTriangle || std::abs(toiTriangle - 0.375) > toleranceTime)
+    ++failures;
+
+  // Off-axis balls: (4t - 3)^2 + 0.6^2 = 1, impact at t = 0.55
+  ball staticBall(0.5, point(0.0, 0.0, 0.0));
+  ball movingBall(0.5, point(-3.0, 0.6, 0.0));
+  real toiBall = QUIET_NAN;
+  bool hitBall = timeOfImpact(&movingBall, identity, affine(translate(4.0, 0.0, 0.0)),
+                              &staticBall, identity, identity, toiBall);
+  if (!hitBall || std::abs(toiBall - 0.55) > toleranceTime)
+    ++failures;
+
+  // Small ball crossing a thin triangle: x(t) = -5 + 10t = -0.05, impact at
+  // t = 0.495, the ball moves 200 times its radius in one step but does not
+  // tunnel through the triangle
+  triangle sliverTriangle(point(0.0, -1.0, 0.0), point(0.0, 1.0, 0.0), point(0.0, 0.0, 0.001));
+  ball fastBall(0.05, point(-5.0, 0.0, 0.0005));
+  affine fastEnd(translate(10.0, 0.0, 0.0));
+  real toiSliver = QUIET_NAN;
+  bool hitSliver = timeOfImpact(&fastBall, identity, fastEnd,
+                                &sliverTriangle, identity, identity, toiSliver);
+  if (!hitSliver || std::abs(toiSliver - 0.495) > toleranceTime)
+    ++failures;
+
+  // The swept box of the fast ball spans its start and end poses
+  aabb sweptBox;
+  if (!sweep(&fastBall, identity, fastEnd, sweptBox) ||
+      std::abs(sweptBox.min(0) + 5.05) > toleranceTime || std::abs(sweptBox.max(0) - 5.05) > toleranceTime ||
+      std::abs(sweptBox.min(1) + 0.05) > toleranceTime || std::abs(sweptBox.max(1) - 0.05) > toleranceTime)
+    ++failures;
+
+  // The collections find the same impact through their swept box trees
+  collection fastBalls, sliverTriangles;
+  fastBalls.push_back(entity::ptr(new ball(fastBall)));
+  sliverTriangles.push_back(entity::ptr(new triangle(sliverTriangle)));
+  integer iSliver = -1, jSliver = -1;
+  real toiSliverCollection = QUIET_NAN;
+  bool hitSliverCollection = fastBalls.timeOfImpact(identity, fastEnd, sliverTriangles, identity, identity,
+                                                    iSliver, jSliver, toiSliverCollection);
+  if (!hitSliverCollection || iSliver != 0 || jSliver != 0 ||
+      std::abs(toiSliverCollection - 0.495) > toleranceTime)
+    ++failures;
+
+  // Balls passing each other at a distance of 1.5 > 1, no impact
+  ball missingBall(0.5, point(-3.0, 1.5, 0.0));
+  real toiMiss = QUIET_NAN;
+  bool hitMiss = timeOfImpact(&missingBall, identity, affine(translate(4.0, 0.0, 0.0)),
+                              &staticBall, identity, identity, toiMiss);
+  if (hitMiss || toiMiss != INFTY)
+    ++failures;
+
+  // Point grazing a diagonal segment at a distance above the tolerance, the
+  // advancement does not converge and only a lower bound of the time is
+  // returned (the diagonal makes the swept boxes overlap)
+  real gap = 1.0e-5 / std::sqrt(2.0);
+  affine diagonal(translate(4.0, 4.0, 0.0));
+  segment longSegment(point(-10.0, -10.0, 0.0), point(10.0, 10.0, 0.0));
+  point grazingPoint(-5.0 + gap, -5.0 - gap, 0.0);
+  real toiGrazing = QUIET_NAN;
+  bool hitGrazing = timeOfImpact(&grazingPoint, identity, diagonal,
+                                 &longSegment, identity, identity, toiGrazing);
+  if (hitGrazing || !(toiGrazing < 1.0))
+    ++failures;
+
+  // The collections report the grazing pair conservatively at the lower bound
+  collection moving, fixed;
+  moving.push_back(entity::ptr(new point(grazingPoint)));
+  fixed.push_back(entity::ptr(new segment(longSegment)));
+  integer i = -1, j = -1;
+  real toiGrazingCollection = QUIET_NAN;
+  bool hitGrazingCollection = moving.timeOfImpact(identity, diagonal, fixed, identity, identity,
+                                                  i, j, toiGrazingCollection);
+  if (!hitGrazingCollection || i != 0 || j != 0 || toiGrazingCollection != toiGrazing)
+    ++failures;
+
+  // The collections report the diagonal balls, (4t - 3)^2 + 0.5^2 = 0.5, at
+  // t = 0.625, before the ball and the segment meet
+  collection movingBalls, fixedBalls;
+  movingBalls.push_back(entity::ptr(new ball(0.5, point(-10.0, 10.0, 0.0))));
+  movingBalls.push_back(entity::ptr(new ball(0.5, point(-2.5, -3.5, 0.0))));
+  fixedBalls.push_back(entity::ptr(new segment(point(-10.0, 5.0, 0.0), point(10.0, 5.0, 0.0))));
+  fixedBalls.push_back(entity::ptr(new ball(staticBall)));
+  real toiCollection = QUIET_NAN;
+  bool hitCollection = movingBalls.timeOfImpact(identity, diagonal, fixedBalls, identity, identity,
+                                                i, j, toiCollection);
+  if (!hitCollection || i != 1 || j != 1 || std::abs(toiCollection - 0.625) > toleranceTime)
+    ++failures;
+
+  std::cout
+      << "Segment-triangle toi   = " << toiSegment << " (exact 0.495)" << std::endl
+      << "Ball-triangle toi      = " << toiTriangle << " (exact 0.375)" << std::endl
+      << "Ball-ball toi          = " << toiBall << " (exact 0.55)" << std::endl
+      << "Ball-sliver toi        = " << toiSliver << " (exact 0.495)" << std::endl
+      << "Ball-sliver coll. toi  = " << toiSliverCollection << " (exact 0.495)" << std::endl
+      << "Ball-ball miss         = " << hitMiss << std::endl
+      << "Grazing hit            = " << hitGrazing << " (lower bound " << toiGrazing << ")" << std::endl
+      << "Grazing collection hit = " << hitGrazingCollection << " (at " << toiGrazingCollection << ")" << std::endl
+      << "Collection toi         = " << toiCollection << " (exact 0.625, entities " << i << ", " << j << ")" << std::endl
+      << std::endl;
+
+  if (failures != 0)
+  {
+    std::cout << "Check the time of impact!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 24: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 25 - PERSISTENT PAIR CACHE
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_collection.hh"
+#include "acme_pairCache.hh"
+#include "acme_segment.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 25 - PERSISTENT PAIR CACHE" << std::endl
+      << std::endl;
+
+  // Two rows of crossing segments, the i-th segments of the rows intersect
+  integer n = 20;
+  collection rowA, rowB;
+  for (integer i = 0; i < n; ++i)
+  {
+    rowA.push_back(entity::ptr(new segment(point(i, 0.0, -0.5), point(i, 0.0, 0.5))));
+    rowB.push_back(entity::ptr(new segment(point(i, -0.5, 0.0), point(i, 0.5, 0.0))));
+  }
+  rowA.buildAABBtree();
+  rowB.buildAABBtree();
+
+  pairCache cache;
+  collection intersections;
+  pairCache::vecpair diagonal;
+  for (integer i = 0; i < n; ++i)
+    diagonal.push_back(std::make_pair(i, i));
+
+  // First step, all the pairs are added and computed
+  rowA.intersection(rowB, cache, intersections);
+  bool step1 = cache.added() == diagonal && cache.persisting().empty() &&
+               cache.removed().empty() && cache.computed() == size_t(n) &&
+               intersections.size() == n;
+  integer computed1 = cache.computed();
+
+  // Second step, nothing moved and nothing is computed
+  rowA.intersection(rowB, cache, intersections);
+  bool step2 = cache.added().empty() && cache.persisting() == diagonal &&
+               cache.removed().empty() && cache.computed() == 0 &&
+               intersections.size() == n;
+  integer computed2 = cache.computed();
+
+  // Third step, the segment A3 leaves its pair, the segment A5 moves to the
+  // pair of B6 and the segment B10 moves along its pair
+  rowA[3]->translate(vec3(0.5, 0.0, 0.0));
+  rowA[5]->translate(vec3(1.0, 0.0, 0.0));
+  rowB[10]->translate(vec3(0.0, 0.1, 0.0));
+  rowA.buildAABBtree();
+  rowB.buildAABBtree();
+  rowA.intersection(rowB, cache, intersections);
+  pairCache::vecpair added, persisting, removed;
+  added.push_back(std::make_pair(5, 6));
+  removed.push_back(std::make_pair(3, 3));
+  removed.push_back(std::make_pair(5, 5));
+  for (integer i = 0; i < n; ++i)
+    if (i != 3 && i != 5)
+      persisting.push_back(std::make_pair(i, i));
+  bool step3 = cache.added() == added && cache.persisting() == persisting &&
+               cache.removed() == removed && cache.computed() == 2 &&
+               intersections.size() == n - 1 && cache.intersection(3, 3) == nullptr &&
+               cache.intersection(5, 6) != nullptr && !cache.intersection(5, 6)->isNone();
+  integer computed3 = cache.computed();
+
+  std::cout
+      << "Step 1 computed       = " << computed1 << std::endl
+      << "Step 2 computed       = " << computed2 << std::endl
+      << "Step 3 computed       = " << computed3 << std::endl
+      << "Step 3 added          = " << cache.added().size() << std::endl
+      << "Step 3 persisting     = " << cache.persisting().size() << std::endl
+      << "Step 3 removed        = " << cache.removed().size() << std::endl
+      << "Step 3 intersections  = " << intersections.size() << std::endl
+      << std::endl;
+
+  if (!step1 || !step2 || !step3)
+  {
+    std::cout << "Check the pair cache!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 25: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
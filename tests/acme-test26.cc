@@ -0,0 +1,159 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 26 - INSTANCED AABB TREE QUERIES
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+
+#include "acme.hh"
+#include "acme_collection.hh"
+#include "acme_instanceTree.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 26 - INSTANCED AABB TREE QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize two meshes of scattered triangles in the unit cube
+  std::vector<collection::ptr> meshes;
+  for (integer m = 0; m < 2; ++m)
+  {
+    collection::ptr mesh(new collection());
+    for (integer k = 0; k < 300; ++k)
+    {
+      real s = 7.0 * m + k;
+      point P(std::sin(1.1 * s), std::sin(2.3 * s + 1.0), std::sin(3.7 * s + 2.0));
+      point Q(P + 0.2 * point(std::cos(1.3 * s), std::cos(1.9 * s), std::cos(2.9 * s)));
+      point R(P + 0.2 * point(std::sin(0.7 * s), std::cos(3.1 * s), std::sin(1.7 * s)));
+      mesh->push_back(entity::ptr(new triangle(P, Q, R)));
+    }
+    meshes.push_back(mesh);
+  }
+
+  // Place the meshes with rigid transformations and flatten the scene
+  instanceTree scene;
+  collection flat;
+  std::vector<std::pair<integer, integer>> source;
+  for (integer i = 0; i < 40; ++i)
+  {
+    vec3 axis(std::sin(0.3 * i), std::cos(0.5 * i), 1.0);
+    affine transform(translate(10.0 * std::sin(0.9 * i), 10.0 * std::cos(1.3 * i), 2.0 * std::sin(0.4 * i)) *
+                     angleaxis(0.7 * i, axis.normalized()));
+    collection const &mesh = *meshes[i % 2];
+    scene.add(meshes[i % 2], transform);
+    for (integer k = 0; k < mesh.size(); ++k)
+    {
+      entity::ptr entity_k(new triangle(*dynamic_cast<triangle const *>(mesh[k].get())));
+      entity_k->transform(transform);
+      flat.push_back(entity_k);
+      source.push_back(std::make_pair(i, k));
+    }
+  }
+  scene.build();
+  flat.buildAABBtree();
+
+  // Raycasts aimed at the instances against the flattened scene, the hits
+  // must match and be among the ray candidates of the instances
+  integer rayHits = 0, rayMismatches = 0;
+  for (integer r = 0; r < 500; ++r)
+  {
+    vec3 direction(std::sin(1.7 * r), std::cos(2.3 * r), 1.0 + 0.5 * std::sin(0.1 * r));
+    point target(scene.getInstance(r % 40).transform * point(0.5 * std::sin(r), 0.5 * std::cos(r), 0.0));
+    ray ray_r(point(target - 5.0 * direction), direction);
+    integer instanceHit, indexHit, flatHit;
+    real t, u, v, w, tFlat, uFlat, vFlat, wFlat;
+    bool hit = scene.raycast(ray_r, instanceHit, indexHit, t, u, v, w);
+    bool hitFlat = flat.raycast(ray_r, flatHit, tFlat, uFlat, vFlat, wFlat);
+    if (hit != hitFlat)
+    {
+      ++rayMismatches;
+      continue;
+    }
+    if (!hit)
+      continue;
+    ++rayHits;
+    instanceTree::vecpair candidates;
+    scene.intersection(ray_r, candidates);
+    std::set<std::pair<integer, integer>> candidateSet(candidates.begin(), candidates.end());
+    if (std::abs(t - tFlat) > EPSILON_LOW * std::max(1.0, tFlat) || !candidateSet.count(source[flatHit]))
+      ++rayMismatches;
+  }
+
+  // Box queries against the flattened scene, the triangles with a vertex in
+  // the box surely overlap it and must be among the candidates
+  integer boxCandidates = 0, boxMismatches = 0;
+  for (integer q = 0; q < 200; ++q)
+  {
+    point center(10.0 * std::sin(0.71 * q), 10.0 * std::cos(0.43 * q), 2.0 * std::sin(0.29 * q));
+    real d = 0.5 + 0.5 * (q % 4);
+    aabb box(center.x() - d, center.y() - d, center.z() - d, center.x() + d, center.y() + d, center.z() + d, q, 0);
+    instanceTree::vecpair candidates;
+    scene.intersection(box, candidates);
+    std::set<std::pair<integer, integer>> candidateSet(candidates.begin(), candidates.end());
+    boxCandidates += candidates.size();
+    for (integer k = 0; k < flat.size(); ++k)
+    {
+      triangle const &triangle_k = *dynamic_cast<triangle const *>(flat[k].get());
+      bool inside = false;
+      for (integer l = 0; l < 3 && !inside; ++l)
+        inside = (triangle_k.vertex(l).array() >= box.min().array()).all() &&
+                 (triangle_k.vertex(l).array() <= box.max().array()).all();
+      if (inside && !candidateSet.count(source[k]))
+        ++boxMismatches;
+    }
+  }
+
+  std::cout
+      << "Instances          = " << scene.size() << std::endl
+      << "Flattened entities = " << flat.size() << std::endl
+      << "Ray hits           = " << rayHits << std::endl
+      << "Ray mismatches     = " << rayMismatches << std::endl
+      << "Box candidates     = " << boxCandidates << std::endl
+      << "Box mismatches     = " << boxMismatches << std::endl
+      << std::endl;
+
+  if (rayMismatches != 0 || boxMismatches != 0)
+  {
+    std::cout << "Check the instanced AABB tree queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 26: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,188 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 27 - PLANE SLICING AND HALF-SPACE QUERIES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_collection.hh"
+#include "acme_plane.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifiers of a candidate list
+std::vector<integer>
+candidateIds(aabb::vecptr const &candidates)
+{
+  std::vector<integer> ids;
+  for (size_t i = 0; i < candidates.size(); ++i)
+    ids.push_back(candidates[i]->id());
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Side of a box with respect to a plane (1 normal side, -1 other side, 0 straddling)
+integer
+boxSide(aabb const &box, plane const &plane_in)
+{
+  real center = -plane_in.normal().dot(plane_in.origin());
+  real radius = 0.0;
+  for (integer k = 0; k < 3; ++k)
+  {
+    center += 0.5 * (box.max(k) + box.min(k)) * plane_in.normal()[k];
+    radius += 0.5 * (box.max(k) - box.min(k)) * std::abs(plane_in.normal()[k]);
+  }
+  if (center > radius)
+    return 1;
+  else if (center < -radius)
+    return -1;
+  else
+    return 0;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 27 - PLANE SLICING AND HALF-SPACE QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize a grid of small boxes with scattered sizes and heights
+  aabb::vecptr vecBox;
+  integer n = 40;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = i + 0.3 * std::sin(1.7 * j);
+      real y = j + 0.3 * std::cos(2.3 * i);
+      real z = 0.5 * std::sin(0.4 * i + 0.7 * j);
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, id, 0)));
+    }
+  }
+
+  // Build the tree with leaves of more boxes
+  AABBtree tree;
+  tree.setLeafSize(4);
+  tree.build(vecBox);
+
+  // Initialize a triangle mesh and its tree with leaves of more boxes
+  collection mesh;
+  for (integer k = 0; k < 1000; ++k)
+  {
+    point P(20.0 * std::sin(1.1 * k), 20.0 * std::sin(2.3 * k + 1.0), std::sin(3.7 * k + 2.0));
+    point Q(P + point(std::cos(1.3 * k), std::cos(1.9 * k), std::cos(2.9 * k)));
+    point R(P + point(std::sin(0.7 * k), std::cos(3.1 * k), std::sin(1.7 * k)));
+    mesh.push_back(entity::ptr(new triangle(P, Q, R)));
+  }
+  mesh.ptrAABBtree()->setLeafSize(4);
+  mesh.buildAABBtree();
+
+  // Compare the queries with brute force on planes of several orientations
+  integer planes = 0;
+  integer boxMismatches = 0;
+  integer entityMismatches = 0;
+  for (integer q = 0; q < 20; ++q)
+  {
+    point origin(20.0 + 10.0 * std::sin(1.3 * q), 20.0 + 10.0 * std::cos(0.9 * q), 0.1 * q - 1.0);
+    vec3 normal(std::sin(0.7 * q), std::cos(1.9 * q), 0.5 * std::sin(2.3 * q));
+    plane plane_q(origin, normal);
+    ++planes;
+
+    // Tree boxes
+    aabb::vecptr slice, inside, straddling;
+    tree.intersection(plane_q, slice);
+    tree.halfSpace(plane_q, inside, straddling);
+    std::vector<integer> sliceBrute, insideBrute;
+    for (size_t i = 0; i < vecBox.size(); ++i)
+    {
+      integer box_side = boxSide(*vecBox[i], plane_q);
+      if (box_side == 0)
+        sliceBrute.push_back(vecBox[i]->id());
+      else if (box_side > 0)
+        insideBrute.push_back(vecBox[i]->id());
+    }
+    if (candidateIds(slice) != sliceBrute || candidateIds(straddling) != sliceBrute ||
+        candidateIds(inside) != insideBrute)
+      ++boxMismatches;
+
+    // Collection entities
+    std::vector<integer> sliceIds, halfIds;
+    mesh.slice(plane_q, sliceIds);
+    mesh.halfSpace(plane_q, halfIds);
+    std::sort(sliceIds.begin(), sliceIds.end());
+    std::sort(halfIds.begin(), halfIds.end());
+    std::vector<integer> sliceEntities, halfEntities;
+    for (integer k = 0; k < mesh.size(); ++k)
+    {
+      triangle const &triangle_k = *dynamic_cast<triangle const *>(mesh[k].get());
+      real min = INFTY, max = -INFTY;
+      for (integer v = 0; v < 3; ++v)
+      {
+        real distance = plane_q.normal().dot(triangle_k.vertex(v) - origin);
+        min = std::min(min, distance);
+        max = std::max(max, distance);
+      }
+      if (min <= 0.0 && max >= 0.0)
+        sliceEntities.push_back(k);
+      else if (min > 0.0)
+        halfEntities.push_back(k);
+    }
+    if (sliceIds != sliceEntities || halfIds != halfEntities)
+      ++entityMismatches;
+  }
+
+  std::cout
+      << "Boxes              = " << vecBox.size() << std::endl
+      << "Entities           = " << mesh.size() << std::endl
+      << "Planes             = " << planes << std::endl
+      << "Box mismatches     = " << boxMismatches << std::endl
+      << "Entity mismatches  = " << entityMismatches << std::endl
+      << std::endl;
+
+  if (boxMismatches != 0 || entityMismatches != 0)
+  {
+    std::cout << "Check the plane queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 27: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
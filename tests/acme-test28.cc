@@ -0,0 +1,189 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 28 - AABB TREE SAVE AND LOAD
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_ray.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Read a whole file
+std::vector<char>
+readFile(std::string const &filename)
+{
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Write a whole file
+void
+writeFile(std::string const &filename, std::vector<char> const &data)
+{
+  std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+  file.write(data.data(), data.size());
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 28 - AABB TREE SAVE AND LOAD" << std::endl
+      << std::endl;
+
+  // Initialize a grid of small boxes with scattered sizes and heights
+  aabb::vecptr vecBox;
+  integer n = 40;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = i + 0.3 * std::sin(1.7 * j);
+      real y = j + 0.3 * std::cos(2.3 * i);
+      real z = 0.5 * std::sin(0.4 * i + 0.7 * j);
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, id, 0)));
+    }
+  }
+
+  // Build the tree with the surface area heuristic and leaves of more boxes,
+  // then save it
+  AABBtree tree;
+  tree.setMethod(AABBtree::SAH, 16, 4.0, 1.0);
+  tree.setLeafSize(4);
+  tree.build(vecBox);
+  std::string filename("acme-test28.aabb");
+  bool saved = tree.save(filename);
+
+  // Load it back on the same boxes
+  AABBtree treeLoaded;
+  bool loaded = treeLoaded.load(filename, vecBox);
+  bool sameNodes = loaded && tree.nodes().size() == treeLoaded.nodes().size() &&
+                   std::memcmp(tree.nodes().data(), treeLoaded.nodes().data(),
+                               tree.nodes().size() * sizeof(AABBtree::node)) == 0;
+  bool sameSettings = loaded && treeLoaded.getMethod() == AABBtree::SAH && treeLoaded.getLeafSize() == 4;
+
+  // Compare box, ray and tree-vs-tree queries
+  integer queryMismatches = 0;
+  for (integer k = 0; k < 50; ++k)
+  {
+    real x = 20.0 + 18.0 * std::sin(0.9 * k);
+    real y = 20.0 + 18.0 * std::cos(1.3 * k);
+    real d = 0.5 + 2.0 * (k % 5);
+    aabb box(x - d, y - d, -0.1, x + d, y + d, 0.1, k, 0);
+    ray ray_k(-1.0, y, 0.0, std::cos(0.13 * k), 0.2 * std::sin(0.13 * k), 0.0);
+    aabb::vecptr boxCandidates, boxCandidatesLoaded, rayCandidates, rayCandidatesLoaded;
+    tree.intersection(box, boxCandidates);
+    treeLoaded.intersection(box, boxCandidatesLoaded);
+    tree.intersection(ray_k, rayCandidates);
+    treeLoaded.intersection(ray_k, rayCandidatesLoaded);
+    if (boxCandidates != boxCandidatesLoaded || rayCandidates != rayCandidatesLoaded)
+      ++queryMismatches;
+  }
+  aabb::vecptr vecQuery;
+  for (integer k = 0; k < 100; ++k)
+  {
+    real x = 20.0 + 18.0 * std::sin(1.7 * k);
+    real y = 20.0 + 18.0 * std::cos(2.9 * k);
+    vecQuery.push_back(aabb::ptr(new aabb(x - 0.5, y - 0.5, -0.5, x + 0.5, y + 0.5, 0.5, k, 0)));
+  }
+  AABBtree treeQuery;
+  treeQuery.build(vecQuery);
+  aabb::vecpairptr pairs, pairsLoaded;
+  tree.intersection(treeQuery, pairs);
+  treeLoaded.intersection(treeQuery, pairsLoaded);
+  if (pairs != pairsLoaded)
+    ++queryMismatches;
+
+  // Reject the file on boxes with a different geometry
+  aabb::vecptr vecMoved(vecBox);
+  aabb const &first = *vecBox[0];
+  vecMoved[0] = aabb::ptr(new aabb(first.min(0) + 0.1, first.min(1), first.min(2),
+                                   first.max(0) + 0.1, first.max(1), first.max(2), first.id(), 0));
+  AABBtree treeMoved;
+  bool rejectedChecksum = !treeMoved.load(filename, vecMoved) && treeMoved.isEmpty();
+
+  // Reject a truncated file
+  std::vector<char> data = readFile(filename);
+  std::string filenameCorrupt("acme-test28-corrupt.aabb");
+  writeFile(filenameCorrupt, std::vector<char>(data.begin(), data.end() - sizeof(integer)));
+  AABBtree treeTruncated;
+  bool rejectedTruncated = !treeTruncated.load(filenameCorrupt, vecBox) && treeTruncated.isEmpty();
+
+  // Reject a root whose right child points back to the root, which would make
+  // the traversals loop forever (the header precedes the nodes and the box
+  // positions)
+  size_t header = data.size() - tree.nodes().size() * sizeof(AABBtree::node) - vecBox.size() * sizeof(integer);
+  std::vector<char> dataCorrupt(data);
+  integer loop = 0;
+  std::memcpy(dataCorrupt.data() + header + offsetof(AABBtree::node, index), &loop, sizeof(integer));
+  writeFile(filenameCorrupt, dataCorrupt);
+  AABBtree treeCorrupt;
+  bool rejectedIndex = !treeCorrupt.load(filenameCorrupt, vecBox) && treeCorrupt.isEmpty();
+
+  std::remove(filename.c_str());
+  std::remove(filenameCorrupt.c_str());
+
+  std::cout
+      << "Boxes              = " << vecBox.size() << std::endl
+      << "Nodes              = " << tree.nodes().size() << std::endl
+      << "Saved              = " << saved << std::endl
+      << "Loaded             = " << loaded << std::endl
+      << "Same nodes         = " << sameNodes << std::endl
+      << "Same settings      = " << sameSettings << std::endl
+      << "Query mismatches   = " << queryMismatches << std::endl
+      << "Checksum rejected  = " << rejectedChecksum << std::endl
+      << "Truncated rejected = " << rejectedTruncated << std::endl
+      << "Index rejected     = " << rejectedIndex << std::endl
+      << std::endl;
+
+  if (!saved || !loaded || !sameNodes || !sameSettings || queryMismatches != 0 ||
+      !rejectedChecksum || !rejectedTruncated || !rejectedIndex)
+  {
+    std::cout << "Check the AABB tree save and load!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 28: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
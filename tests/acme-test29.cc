@@ -0,0 +1,155 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 29 - AABB TREE SELF-INTERSECTION
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_collection.hh"
+#include "acme_intersection.hh"
+#include "acme_segment.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifier pairs of a pair list, smallest identifier first
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+  {
+    integer first = pairs[i].first->id();
+    integer second = pairs[i].second->id();
+    ids.push_back(std::make_pair(std::min(first, second), std::max(first, second)));
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 29 - AABB TREE SELF-INTERSECTION" << std::endl
+      << std::endl;
+
+  // Initialize scattered segments in a plane and their boxes
+  collection segments;
+  for (integer k = 0; k < 600; ++k)
+  {
+    point P(10.0 + 10.0 * std::sin(1.1 * k), 10.0 + 10.0 * std::sin(2.3 * k + 1.0), 0.0);
+    point Q(P + 2.0 * point(std::cos(1.3 * k), std::sin(1.3 * k), 0.0));
+    segments.push_back(entity::ptr(new segment(P, Q)));
+  }
+  aabb::vecptr vecBox;
+  segments.clamp(vecBox);
+
+  // Brute force pairs of distinct overlapping boxes
+  std::vector<std::pair<integer, integer>> pairsBrute;
+  for (size_t i = 0; i < vecBox.size(); ++i)
+    for (size_t j = i + 1; j < vecBox.size(); ++j)
+      if (vecBox[i]->intersects(*vecBox[j]))
+        pairsBrute.push_back(std::make_pair(vecBox[i]->id(), vecBox[j]->id()));
+  std::sort(pairsBrute.begin(), pairsBrute.end());
+
+  // Brute force intersections of distinct entities
+  integer intersectionsBrute = 0;
+  for (integer i = 0; i < segments.size(); ++i)
+  {
+    for (integer j = i + 1; j < segments.size(); ++j)
+    {
+      entity::ptr entity_ij(acme::intersection(segments[i].get(), segments[j].get()));
+      if (!entity_ij->isNone())
+        ++intersectionsBrute;
+    }
+  }
+
+  // Compare the self-intersections with single-box and multi-box leaves,
+  // every unordered pair must appear exactly once and never with itself
+  integer leafSizes[3] = {1, 4, 8};
+  integer pairMismatches = 0;
+  integer selfPairs = 0;
+  integer intersectionMismatches = 0;
+  for (integer l = 0; l < 3; ++l)
+  {
+    AABBtree tree;
+    tree.setLeafSize(leafSizes[l]);
+    tree.build(vecBox);
+    aabb::vecpairptr pairs;
+    tree.selfIntersection(pairs);
+    std::vector<std::pair<integer, integer>> ids(pairIds(pairs));
+    for (size_t i = 0; i < ids.size(); ++i)
+      if (ids[i].first == ids[i].second)
+        ++selfPairs;
+    if (ids != pairsBrute)
+      ++pairMismatches;
+
+    segments.ptrAABBtree()->setLeafSize(leafSizes[l]);
+    segments.buildAABBtree();
+    collection intersections;
+    segments.intersection(intersections);
+    if (intersections.size() != intersectionsBrute)
+      ++intersectionMismatches;
+  }
+
+  // The collection builds its tree on the fly if empty
+  segments.ptrAABBtree()->clear();
+  collection intersectionsOnTheFly;
+  segments.intersection(intersectionsOnTheFly);
+  if (intersectionsOnTheFly.size() != intersectionsBrute)
+    ++intersectionMismatches;
+
+  std::cout
+      << "Boxes                   = " << vecBox.size() << std::endl
+      << "Overlapping box pairs   = " << pairsBrute.size() << std::endl
+      << "Entity intersections    = " << intersectionsBrute << std::endl
+      << "Pair mismatches         = " << pairMismatches << std::endl
+      << "Self pairs              = " << selfPairs << std::endl
+      << "Intersection mismatches = " << intersectionMismatches << std::endl
+      << std::endl;
+
+  if (pairMismatches != 0 || selfPairs != 0 || intersectionMismatches != 0)
+  {
+    std::cout << "Check the self-intersection!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 29: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
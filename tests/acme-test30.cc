@@ -0,0 +1,152 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 30 - PARALLEL AABB TREE INTERSECTION
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifier pairs of a pair list
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+    ids.push_back(std::make_pair(pairs[i].first->id(), pairs[i].second->id()));
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 30 - PARALLEL AABB TREE INTERSECTION" << std::endl
+      << std::endl;
+
+  // Initialize two grids of small boxes, large enough for the parallel traversal
+  aabb::vecptr vecBox, vecQuery;
+  integer n = 60;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real x = i + 0.3 * std::sin(1.7 * j);
+      real y = j + 0.3 * std::cos(2.3 * i);
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, -d, x + d, y + d, d, id, 0)));
+      x = i + 0.5 + 0.4 * std::cos(0.9 * j);
+      y = j + 0.5 + 0.4 * std::sin(1.3 * i);
+      vecQuery.push_back(aabb::ptr(new aabb(x - 0.2, y - 0.2, -0.2, x + 0.2, y + 0.2, 0.2, id, 0)));
+    }
+  }
+  AABBtree tree;
+  tree.build(vecBox);
+  tree.setCounting(true);
+
+  // Query with the whole grid and with a few boxes, whose traversal reaches
+  // pairs of leaves while expanding the top levels
+  aabb::vecptr vecFew(vecQuery.begin(), vecQuery.begin() + 3);
+  AABBtree treeQueries[2];
+  treeQueries[0].build(vecQuery);
+  treeQueries[1].build(vecFew);
+
+  integer threads[4] = {1, 2, 3, 8};
+  integer pairMismatches = 0;
+  integer orderMismatches = 0;
+  integer visitedMismatches = 0;
+  size_t pairsTotal = 0;
+  for (integer q = 0; q < 2; ++q)
+  {
+    // Serial reference
+    aabb::vecpairptr pairsSerial;
+    tree.resetCounters();
+    tree.intersection(treeQueries[q], pairsSerial);
+    size_t visitedSerial = tree.getCounters().nodes;
+    std::vector<std::pair<integer, integer>> idsSerial(pairIds(pairsSerial));
+    pairsTotal += pairsSerial.size();
+
+    // Compare the parallel traversal for several thread counts, the
+    // deterministic one must also keep the serial order and both must visit
+    // every node pair once
+    for (integer t = 0; t < 4; ++t)
+    {
+#ifdef _OPENMP
+      omp_set_num_threads(threads[t]);
+#endif
+      aabb::vecpairptr pairsDeterministic, pairsUnordered;
+      tree.resetCounters();
+      tree.parallelIntersection(treeQueries[q], pairsDeterministic, true);
+      if (tree.getCounters().nodes != visitedSerial)
+        ++visitedMismatches;
+      tree.resetCounters();
+      tree.parallelIntersection(treeQueries[q], pairsUnordered, false);
+      if (tree.getCounters().nodes != visitedSerial)
+        ++visitedMismatches;
+      if (pairsDeterministic != pairsSerial)
+        ++orderMismatches;
+      if (pairIds(pairsDeterministic) != idsSerial || pairIds(pairsUnordered) != idsSerial)
+        ++pairMismatches;
+    }
+  }
+
+  std::cout
+      << "Boxes              = " << vecBox.size() << std::endl
+      << "Pairs              = " << pairsTotal << std::endl
+      << "Pair mismatches    = " << pairMismatches << std::endl
+      << "Order mismatches   = " << orderMismatches << std::endl
+      << "Visit mismatches   = " << visitedMismatches << std::endl
+      << std::endl;
+
+  if (pairMismatches != 0 || orderMismatches != 0 || visitedMismatches != 0)
+  {
+    std::cout << "Check the parallel intersection!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 30: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
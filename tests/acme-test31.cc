@@ -0,0 +1,167 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 31 - COLLECTION RAYCAST
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "acme.hh"
+#include "acme_collection.hh"
+#include "acme_ray.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Ray parameter of the hit with a triangle by a linear solve (infinity if missed)
+real
+hitTriangle(ray const &ray_in, triangle const &triangle_in)
+{
+  mat3 matrix;
+  matrix.col(0) = triangle_in.vertex(1) - triangle_in.vertex(0);
+  matrix.col(1) = triangle_in.vertex(2) - triangle_in.vertex(0);
+  matrix.col(2) = -ray_in.direction();
+  vec3 solution(matrix.fullPivLu().solve(ray_in.origin() - triangle_in.vertex(0)));
+  if (solution[0] < 0.0 || solution[1] < 0.0 || solution[0] + solution[1] > 1.0 || solution[2] < 0.0)
+    return INFTY;
+  return solution[2];
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 31 - COLLECTION RAYCAST" << std::endl
+      << std::endl;
+
+  // Initialize three stacked layers of triangles covering [0,10]x[0,10]
+  collection layers;
+  for (integer l = 0; l < 3; ++l)
+  {
+    real z = l + 0.1 * std::sin(1.0 * l);
+    for (integer i = 0; i < 10; ++i)
+    {
+      for (integer j = 0; j < 10; ++j)
+      {
+        point P(i, j, z), Q(i + 1, j, z + 0.05), R(i + 1, j + 1, z), S(i, j + 1, z - 0.05);
+        layers.push_back(entity::ptr(new triangle(P, Q, R)));
+        layers.push_back(entity::ptr(new triangle(P, R, S)));
+      }
+    }
+  }
+  layers.buildAABBtree();
+
+  // Cast tilted rays from above and below the layers, some of them miss
+  real tolerance = 1.0e-9;
+  integer rays = 0, hits = 0;
+  integer closestMismatches = 0, anyHitMismatches = 0, barycentricMismatches = 0, cutoffMismatches = 0;
+  for (integer k = 0; k < 200; ++k)
+  {
+    real x = 5.0 + 6.0 * std::sin(0.37 * k);
+    real y = 5.0 + 4.5 * std::cos(0.53 * k);
+    real side = k % 2 == 0 ? 1.0 : -1.0;
+    ray ray_k(point(x, y, 1.0 + 5.0 * side), vec3(0.1 * std::sin(k), 0.1 * std::cos(k), -side));
+    ++rays;
+
+    // Brute force closest hit
+    real tBrute = INFTY;
+    for (integer e = 0; e < layers.size(); ++e)
+      tBrute = std::min(tBrute, hitTriangle(ray_k, *dynamic_cast<triangle const *>(layers[e].get())));
+
+    // Closest hit
+    integer index = -1;
+    real t = QUIET_NAN, u = QUIET_NAN, v = QUIET_NAN, w = QUIET_NAN;
+    bool hit = layers.raycast(ray_k, index, t, u, v, w);
+    if (hit != (tBrute < INFTY) || (hit && std::abs(t - tBrute) > tolerance))
+    {
+      ++closestMismatches;
+      continue;
+    }
+    if (!hit)
+      continue;
+    ++hits;
+
+    // The barycentric coordinates sum to one and reproduce the hit point
+    triangle const &triangle_k = *dynamic_cast<triangle const *>(layers[index].get());
+    point hitPoint(u * triangle_k.vertex(0) + v * triangle_k.vertex(1) + w * triangle_k.vertex(2));
+    if (std::abs(u + v + w - 1.0) > tolerance ||
+        (hitPoint - (ray_k.origin() + t * ray_k.direction())).norm() > tolerance)
+      ++barycentricMismatches;
+
+    // Any hit returns a hit of the ray, not necessarily the closest one
+    integer indexAny = -1;
+    real tAny = QUIET_NAN, uAny, vAny, wAny;
+    bool hitAny = layers.raycast(ray_k, indexAny, tAny, uAny, vAny, wAny, INFTY, true);
+    if (!hitAny || tAny < t - tolerance ||
+        std::abs(hitTriangle(ray_k, *dynamic_cast<triangle const *>(layers[indexAny].get())) - tAny) > tolerance)
+      ++anyHitMismatches;
+
+    // The maximum ray parameter cuts the hits beyond it
+    integer indexCut;
+    real tCut, uCut, vCut, wCut;
+    if (layers.raycast(ray_k, indexCut, tCut, uCut, vCut, wCut, 0.999 * t) ||
+        layers.raycast(ray_k, indexCut, tCut, uCut, vCut, wCut, 0.999 * t, true) ||
+        !layers.raycast(ray_k, indexCut, tCut, uCut, vCut, wCut, 1.001 * t) ||
+        std::abs(tCut - t) > tolerance)
+      ++cutoffMismatches;
+  }
+
+  // A tiny triangle hit head-on, its determinant is far below the machine
+  // epsilon but not relative to its edges
+  collection tiny;
+  tiny.push_back(entity::ptr(new triangle(point(0.0, 0.0, 0.0), point(1.0e-8, 0.0, 0.0), point(0.0, 1.0e-8, 0.0))));
+  tiny.buildAABBtree();
+  integer indexTiny = -1;
+  real tTiny = QUIET_NAN, uTiny, vTiny, wTiny;
+  bool hitTiny = tiny.raycast(ray(point(2.0e-9, 2.0e-9, 1.0), vec3(0.0, 0.0, -1.0)), indexTiny, tTiny, uTiny, vTiny, wTiny);
+  if (!hitTiny || indexTiny != 0 || std::abs(tTiny - 1.0) > tolerance)
+    ++closestMismatches;
+
+  std::cout
+      << "Rays                   = " << rays << std::endl
+      << "Hits                   = " << hits << std::endl
+      << "Tiny triangle hit      = " << hitTiny << std::endl
+      << "Closest mismatches     = " << closestMismatches << std::endl
+      << "Any-hit mismatches     = " << anyHitMismatches << std::endl
+      << "Barycentric mismatches = " << barycentricMismatches << std::endl
+      << "Cut-off mismatches     = " << cutoffMismatches << std::endl
+      << std::endl;
+
+  if (closestMismatches != 0 || anyHitMismatches != 0 || barycentricMismatches != 0 || cutoffMismatches != 0)
+  {
+    std::cout << "Check the collection raycast!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 31: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,237 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 32 - AABB TREE REFIT
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_collection.hh"
+#include "acme_ray.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifiers of a candidate list
+std::vector<integer>
+candidateIds(aabb::vecptr const &candidates)
+{
+  std::vector<integer> ids;
+  for (size_t i = 0; i < candidates.size(); ++i)
+    ids.push_back(candidates[i]->id());
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Sorted identifier pairs of a pair list
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+    ids.push_back(std::make_pair(pairs[i].first->id(), pairs[i].second->id()));
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Sorted entity addresses of a collection
+std::vector<entity const *>
+entityAddresses(collection &entities)
+{
+  std::vector<entity const *> addresses;
+  for (integer i = 0; i < entities.size(); ++i)
+    addresses.push_back(entities[i].get());
+  std::sort(addresses.begin(), addresses.end());
+  return addresses;
+}
+
+// Count the box, ray and tree-vs-tree queries that differ between two trees
+integer
+queryMismatches(AABBtree const &tree, AABBtree const &reference, AABBtree const &treeQuery)
+{
+  integer mismatches = 0;
+  for (integer k = 0; k < 40; ++k)
+  {
+    real x = 15.0 + 14.0 * std::sin(0.9 * k);
+    real y = 15.0 + 14.0 * std::cos(1.3 * k);
+    real d = 0.5 + 1.5 * (k % 4);
+    aabb box(x - d, y - d, -2.0, x + d, y + d, 2.0, k, 0);
+    ray ray_k(-1.0, y, 0.0, std::cos(0.13 * k), 0.2 * std::sin(0.13 * k), 0.0);
+    aabb::vecptr boxCandidates, boxReference, rayCandidates, rayReference;
+    tree.intersection(box, boxCandidates);
+    reference.intersection(box, boxReference);
+    tree.intersection(ray_k, rayCandidates);
+    reference.intersection(ray_k, rayReference);
+    if (candidateIds(boxCandidates) != candidateIds(boxReference) ||
+        candidateIds(rayCandidates) != candidateIds(rayReference))
+      ++mismatches;
+  }
+  aabb::vecpairptr pairs, pairsReference;
+  tree.intersection(treeQuery, pairs);
+  reference.intersection(treeQuery, pairsReference);
+  if (pairIds(pairs) != pairIds(pairsReference))
+    ++mismatches;
+  return mismatches;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 32 - AABB TREE REFIT" << std::endl
+      << std::endl;
+
+  // Initialize a grid of small boxes and a scattered query tree
+  aabb::vecptr vecBox;
+  integer n = 30;
+  for (integer i = 0; i < n; ++i)
+  {
+    for (integer j = 0; j < n; ++j)
+    {
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      integer id = vecBox.size();
+      vecBox.push_back(aabb::ptr(new aabb(i - d, j - d, -d, i + d, j + d, d, id, 0)));
+    }
+  }
+  aabb::vecptr vecQuery;
+  for (integer k = 0; k < 100; ++k)
+  {
+    real x = 15.0 + 14.0 * std::sin(1.7 * k);
+    real y = 15.0 + 14.0 * std::cos(2.9 * k);
+    vecQuery.push_back(aabb::ptr(new aabb(x - 0.5, y - 0.5, -0.5, x + 0.5, y + 0.5, 0.5, k, 0)));
+  }
+  AABBtree treeQuery;
+  treeQuery.build(vecQuery);
+
+  integer leafSizes[2] = {1, 4};
+  integer refitMismatches = 0;
+  real degradationBuild[2], degradationWave[2], degradationShuffle[2];
+  for (integer l = 0; l < 2; ++l)
+  {
+    AABBtree tree;
+    tree.setLeafSize(leafSizes[l]);
+    tree.build(vecBox);
+    degradationBuild[l] = tree.degradation();
+
+    // Move the boxes in place along a smooth wave and refit
+    std::vector<std::shared_ptr<aabb>> waveBoxes;
+    aabb::vecptr vecWave;
+    for (size_t b = 0; b < vecBox.size(); ++b)
+    {
+      aabb const &box = *vecBox[b];
+      real shift = 0.7 * std::sin(0.3 * box.min(0)) * std::cos(0.2 * box.min(1));
+      waveBoxes.push_back(std::make_shared<aabb>(box.min(0) + shift, box.min(1) - shift, box.min(2) + shift,
+                                                 box.max(0) + shift, box.max(1) - shift, box.max(2) + shift,
+                                                 box.id(), 0));
+      vecWave.push_back(waveBoxes.back());
+    }
+    tree.refit(vecWave);
+    degradationWave[l] = tree.degradation();
+    AABBtree treeWave;
+    treeWave.setLeafSize(leafSizes[l]);
+    treeWave.build(vecWave);
+    refitMismatches += queryMismatches(tree, treeWave, treeQuery);
+
+    // Shuffle the boxes in place, the topology no longer fits them
+    std::vector<std::pair<point, point>> corners;
+    for (size_t b = 0; b < vecWave.size(); ++b)
+      corners.push_back(std::make_pair(vecWave[b]->min(), vecWave[b]->max()));
+    for (size_t b = 0; b < vecWave.size(); ++b)
+    {
+      size_t c = (b * 7919) % vecWave.size();
+      waveBoxes[b]->min() = corners[c].first;
+      waveBoxes[b]->max() = corners[c].second;
+    }
+    tree.refit();
+    degradationShuffle[l] = tree.degradation();
+    AABBtree treeShuffle;
+    treeShuffle.setLeafSize(leafSizes[l]);
+    treeShuffle.build(vecWave);
+    refitMismatches += queryMismatches(tree, treeShuffle, treeQuery);
+  }
+
+  // Move the triangles of a collection and refit its tree
+  collection mesh, meshRebuilt;
+  for (integer k = 0; k < 500; ++k)
+  {
+    point P(15.0 + 14.0 * std::sin(1.1 * k), 15.0 + 14.0 * std::sin(2.3 * k + 1.0), std::sin(3.7 * k));
+    entity::ptr triangle_k(new triangle(P, P + point(0.5, 0.1, 0.0), P + point(0.0, 0.5, 0.2)));
+    mesh.push_back(triangle_k);
+    meshRebuilt.push_back(triangle_k);
+  }
+  mesh.buildAABBtree();
+  for (integer k = 0; k < mesh.size(); ++k)
+    mesh[k]->translate(vec3(2.0 * std::cos(0.7 * k), 2.0 * std::sin(0.3 * k), 0.0));
+  mesh.refitAABBtree();
+  meshRebuilt.buildAABBtree();
+  integer collectionMismatches = 0;
+  for (integer k = 0; k < 40; ++k)
+  {
+    real x = 15.0 + 14.0 * std::sin(0.9 * k);
+    real y = 15.0 + 14.0 * std::cos(1.3 * k);
+    aabb::ptr box(new aabb(x - 2.0, y - 2.0, -2.0, x + 2.0, y + 2.0, 2.0, k, 0));
+    collection candidates, candidatesRebuilt;
+    mesh.intersection(box, candidates);
+    meshRebuilt.intersection(box, candidatesRebuilt);
+    if (entityAddresses(candidates) != entityAddresses(candidatesRebuilt))
+      ++collectionMismatches;
+  }
+
+  std::cout
+      << "Boxes                 = " << vecBox.size() << std::endl
+      << "Degradation (build)   = " << degradationBuild[0] << ", " << degradationBuild[1] << std::endl
+      << "Degradation (wave)    = " << degradationWave[0] << ", " << degradationWave[1] << std::endl
+      << "Degradation (shuffle) = " << degradationShuffle[0] << ", " << degradationShuffle[1] << std::endl
+      << "Refit mismatches      = " << refitMismatches << std::endl
+      << "Collection mismatches = " << collectionMismatches << std::endl
+      << std::endl;
+
+  bool degradationValid = true;
+  for (integer l = 0; l < 2; ++l)
+    degradationValid = degradationValid && std::abs(degradationBuild[l] - 1.0) < EPSILON &&
+                       degradationShuffle[l] > 2.0 * degradationWave[l];
+  if (refitMismatches != 0 || collectionMismatches != 0 || !degradationValid)
+  {
+    std::cout << "Check the AABB tree refit!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 32: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
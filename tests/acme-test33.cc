@@ -0,0 +1,206 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 33 - NEAREST NEIGHBOUR AND RANGE QUERIES
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_ball.hh"
+#include "acme_collection.hh"
+#include "acme_distance.hh"
+#include "acme_triangle.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Distance of a point to a box
+real
+boxDistance(aabb const &box, point const &query)
+{
+  real squared = 0.0;
+  for (integer k = 0; k < 3; ++k)
+  {
+    real d = std::max(0.0, std::max(box.min(k) - query[k], query[k] - box.max(k)));
+    squared += d * d;
+  }
+  return std::sqrt(squared);
+}
+
+// Check that a nearest list has the k smallest distances in increasing order
+bool
+nearestValid(std::vector<real> const &distances, std::vector<real> const &actual, std::vector<real> brute, integer k)
+{
+  std::sort(brute.begin(), brute.end());
+  size_t size = std::min(static_cast<size_t>(k), brute.size());
+  if (distances.size() != size || actual.size() != size)
+    return false;
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (std::abs(distances[i] - brute[i]) > EPSILON || std::abs(actual[i] - distances[i]) > EPSILON)
+      return false;
+    if (i > 0 && distances[i] < distances[i - 1])
+      return false;
+  }
+  return true;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 33 - NEAREST NEIGHBOUR AND RANGE QUERIES" << std::endl
+      << std::endl;
+
+  // Initialize scattered boxes of different sizes
+  aabb::vecptr vecBox;
+  for (integer k = 0; k < 1000; ++k)
+  {
+    real x = 10.0 + 10.0 * std::sin(1.1 * k);
+    real y = 10.0 + 10.0 * std::sin(2.3 * k + 1.0);
+    real z = 2.0 * std::sin(3.7 * k + 2.0);
+    real d = 0.1 + 0.3 * (k % 5);
+    vecBox.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, k, 0)));
+  }
+
+  // Initialize scattered triangles
+  collection mesh;
+  for (integer k = 0; k < 500; ++k)
+  {
+    point P(10.0 + 10.0 * std::sin(0.7 * k), 10.0 + 10.0 * std::cos(1.9 * k), std::sin(2.9 * k));
+    point Q(P + point(std::cos(1.3 * k), std::sin(0.4 * k), 0.2));
+    point R(P + point(std::sin(1.7 * k), std::cos(2.2 * k), -0.2));
+    mesh.push_back(entity::ptr(new triangle(P, Q, R)));
+  }
+
+  integer ks[4] = {1, 5, 32, 2000};
+  integer leafSizes[2] = {1, 4};
+  integer queries = 0;
+  integer nearestMismatches = 0, rangeMismatches = 0;
+  integer nearestEntityMismatches = 0, closestMismatches = 0, withinMismatches = 0;
+  for (integer l = 0; l < 2; ++l)
+  {
+    AABBtree tree;
+    tree.setLeafSize(leafSizes[l]);
+    tree.build(vecBox);
+    mesh.ptrAABBtree()->setLeafSize(leafSizes[l]);
+    mesh.buildAABBtree();
+    for (integer q = 0; q < 30; ++q)
+    {
+      point query(10.0 + 12.0 * std::sin(0.9 * q), 10.0 + 12.0 * std::cos(1.3 * q), std::sin(0.5 * q));
+      real radius = 0.5 + 0.5 * (q % 6);
+      ++queries;
+
+      // Tree boxes nearest to the point and overlapping a ball
+      std::vector<real> bruteBoxes;
+      std::vector<integer> rangeBrute;
+      for (size_t b = 0; b < vecBox.size(); ++b)
+      {
+        bruteBoxes.push_back(boxDistance(*vecBox[b], query));
+        if (bruteBoxes.back() <= radius)
+          rangeBrute.push_back(vecBox[b]->id());
+      }
+      for (integer i = 0; i < 4; ++i)
+      {
+        aabb::vecptr candidates;
+        std::vector<real> distances, actual;
+        tree.nearest(query, ks[i], candidates, distances);
+        for (size_t c = 0; c < candidates.size(); ++c)
+          actual.push_back(boxDistance(*candidates[c], query));
+        if (!nearestValid(distances, actual, bruteBoxes, ks[i]))
+          ++nearestMismatches;
+      }
+      aabb::vecptr inRange;
+      tree.intersection(ball(radius, query), inRange);
+      std::vector<integer> rangeIds;
+      for (size_t c = 0; c < inRange.size(); ++c)
+        rangeIds.push_back(inRange[c]->id());
+      std::sort(rangeIds.begin(), rangeIds.end());
+      if (rangeIds != rangeBrute)
+        ++rangeMismatches;
+
+      // Collection entities nearest, closest and within a distance
+      std::vector<real> bruteEntities;
+      std::vector<integer> withinBrute;
+      for (integer e = 0; e < mesh.size(); ++e)
+      {
+        bruteEntities.push_back(distance(query, mesh[e].get()));
+        if (bruteEntities.back() <= radius)
+          withinBrute.push_back(e);
+      }
+      for (integer i = 0; i < 4; ++i)
+      {
+        collection candidates;
+        std::vector<real> distances, actual;
+        mesh.nearest(query, ks[i], candidates, distances);
+        for (integer c = 0; c < candidates.size(); ++c)
+          actual.push_back(distance(query, candidates[c].get()));
+        if (!nearestValid(distances, actual, bruteEntities, ks[i]))
+          ++nearestEntityMismatches;
+      }
+      entity::ptr closestEntity;
+      real closestDistance = QUIET_NAN;
+      if (!mesh.closest(query, closestEntity, closestDistance) ||
+          std::abs(closestDistance - *std::min_element(bruteEntities.begin(), bruteEntities.end())) > EPSILON ||
+          std::abs(distance(query, closestEntity.get()) - closestDistance) > EPSILON)
+        ++closestMismatches;
+      std::vector<integer> withinIds;
+      mesh.within(query, radius, withinIds);
+      std::sort(withinIds.begin(), withinIds.end());
+      if (withinIds != withinBrute)
+        ++withinMismatches;
+    }
+  }
+
+  std::cout
+      << "Queries                   = " << queries << std::endl
+      << "Nearest box mismatches    = " << nearestMismatches << std::endl
+      << "Ball range mismatches     = " << rangeMismatches << std::endl
+      << "Nearest entity mismatches = " << nearestEntityMismatches << std::endl
+      << "Closest entity mismatches = " << closestMismatches << std::endl
+      << "Within mismatches         = " << withinMismatches << std::endl
+      << std::endl;
+
+  if (nearestMismatches != 0 || rangeMismatches != 0 || nearestEntityMismatches != 0 ||
+      closestMismatches != 0 || withinMismatches != 0)
+  {
+    std::cout << "Check the nearest neighbour and range queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 33: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,227 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 34 - AABB TREE QUERIES UNDER AN AFFINE TRANSFORMATION
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Sorted identifier pairs of a pair list
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+    ids.push_back(std::make_pair(pairs[i].first->id(), pairs[i].second->id()));
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Box bounding a box placed by an affine transformation
+aabb::ptr
+transformedBox(aabb const &box, affine const &transform)
+{
+  point min(INFTY, INFTY, INFTY), max(-INFTY, -INFTY, -INFTY);
+  for (integer c = 0; c < 8; ++c)
+  {
+    point corner(c & 1 ? box.max(0) : box.min(0), c & 2 ? box.max(1) : box.min(1), c & 4 ? box.max(2) : box.min(2));
+    point placed(transform * corner);
+    min = min.cwiseMin(placed);
+    max = max.cwiseMax(placed);
+  }
+  return aabb::ptr(new aabb(min.x(), min.y(), min.z(), max.x(), max.y(), max.z(), box.id(), 0));
+}
+
+// Exact overlap of a box with a box placed by a rigid transformation, by the
+// separating axis test on the face and edge cross product axes
+bool
+overlapExact(aabb const &box0, aabb const &box1, affine const &transform)
+{
+  mat3 rotation(transform.linear());
+  vec3 half0(0.5 * (box0.max() - box0.min()));
+  vec3 half1(0.5 * (box1.max() - box1.min()));
+  vec3 center0(0.5 * (box0.max() + box0.min()));
+  vec3 center1(transform * point(0.5 * (box1.max() + box1.min())));
+  vec3 axes[15];
+  integer size = 0;
+  for (integer i = 0; i < 3; ++i)
+  {
+    axes[size++] = vec3::Unit(i);
+    axes[size++] = rotation.col(i);
+    for (integer j = 0; j < 3; ++j)
+      axes[size++] = vec3::Unit(i).cross(rotation.col(j));
+  }
+  for (integer a = 0; a < size; ++a)
+  {
+    vec3 const &axis = axes[a];
+    if (axis.squaredNorm() < EPSILON)
+      continue;
+    real radius0 = 0.0, radius1 = 0.0;
+    for (integer i = 0; i < 3; ++i)
+    {
+      radius0 += half0[i] * std::abs(axis[i]);
+      radius1 += half1[i] * std::abs(axis.dot(rotation.col(i)));
+    }
+    if (std::abs(axis.dot(center1 - center0)) > radius0 + radius1)
+      return false;
+  }
+  return true;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 34 - AABB TREE QUERIES UNDER AN AFFINE TRANSFORMATION" << std::endl
+      << std::endl;
+
+  // Initialize a grid of boxes in the world frame and a body of boxes in its
+  // own frame
+  aabb::vecptr vecWorld, vecBody;
+  for (integer i = 0; i < 30; ++i)
+  {
+    for (integer j = 0; j < 30; ++j)
+    {
+      real d = 0.2 + 0.15 * std::sin(3.1 * (i + j));
+      real z = 0.5 * std::sin(0.4 * i + 0.7 * j);
+      vecWorld.push_back(aabb::ptr(new aabb(i - d, j - d, z - d, i + d, j + d, z + d, vecWorld.size(), 0)));
+    }
+  }
+  for (integer k = 0; k < 400; ++k)
+  {
+    real x = 5.0 * std::sin(1.3 * k);
+    real y = 5.0 * std::cos(1.7 * k);
+    real z = 0.5 * std::sin(2.9 * k);
+    real d = 0.1 + 0.1 * (k % 4);
+    vecBody.push_back(aabb::ptr(new aabb(x - 2.0 * d, y - d, z - d, x + 2.0 * d, y + d, z + d, k, 0)));
+  }
+
+  integer leafSizes[2] = {1, 4};
+  integer poses = 0;
+  integer exactMissing = 0, rebuildExtra = 0, collisionMismatches = 0;
+  size_t pairsAffine = 0, pairsRebuild = 0, pairsExact = 0;
+  for (integer l = 0; l < 2; ++l)
+  {
+    AABBtree treeWorld, treeBody;
+    treeWorld.setLeafSize(leafSizes[l]);
+    treeBody.setLeafSize(leafSizes[l]);
+    treeWorld.build(vecWorld);
+    treeBody.build(vecBody);
+    for (integer p = 0; p < 10; ++p)
+    {
+      // Rotation and translation of the body
+      vec3 axis(std::sin(0.7 * p), std::cos(1.1 * p), 0.5 + 0.3 * std::sin(1.9 * p));
+      affine transform(translate(15.0 + 8.0 * std::sin(0.9 * p), 15.0 + 8.0 * std::cos(1.3 * p), 0.1 * p) *
+                       Eigen::AngleAxis<real>(0.4 + 0.5 * p, axis.normalized()));
+      ++poses;
+
+      // Query with the body tree placed by the transformation
+      aabb::vecpairptr pairs;
+      treeWorld.intersection(treeBody, transform, pairs);
+      std::vector<std::pair<integer, integer>> ids(pairIds(pairs));
+
+      // Rebuild the body tree on its transformed boxes and query normally,
+      // the bounding boxes of the placed boxes overlap more often
+      aabb::vecptr vecPlaced;
+      for (size_t b = 0; b < vecBody.size(); ++b)
+        vecPlaced.push_back(transformedBox(*vecBody[b], transform));
+      AABBtree treePlaced;
+      treePlaced.setLeafSize(leafSizes[l]);
+      treePlaced.build(vecPlaced);
+      aabb::vecpairptr pairsPlaced;
+      treeWorld.intersection(treePlaced, pairsPlaced);
+      std::vector<std::pair<integer, integer>> idsPlaced(pairIds(pairsPlaced));
+      for (size_t i = 0; i < ids.size(); ++i)
+        if (!std::binary_search(idsPlaced.begin(), idsPlaced.end(), ids[i]))
+          ++rebuildExtra;
+
+      // Every exactly overlapping pair must be found
+      for (size_t i = 0; i < idsPlaced.size(); ++i)
+      {
+        aabb const &box0 = *vecWorld[idsPlaced[i].first];
+        aabb const &box1 = *vecBody[idsPlaced[i].second];
+        if (!overlapExact(box0, box1, transform))
+          continue;
+        ++pairsExact;
+        if (!std::binary_search(ids.begin(), ids.end(), idsPlaced[i]))
+          ++exactMissing;
+      }
+      pairsAffine += ids.size();
+      pairsRebuild += idsPlaced.size();
+
+      // The collision finds a pair if and only if the intersection does, and
+      // finds a given pair
+      bool collide = treeWorld.collision(
+          treeBody, transform, [](aabb::ptr const &, aabb::ptr const &) { return true; });
+      if (collide != !ids.empty())
+        ++collisionMismatches;
+      if (!ids.empty())
+      {
+        std::pair<integer, integer> target(ids[ids.size() / 2]);
+        bool found = treeWorld.collision(
+            treeBody, transform, [&target](aabb::ptr const &box0, aabb::ptr const &box1) {
+              return box0->id() == target.first && box1->id() == target.second;
+            });
+        if (!found)
+          ++collisionMismatches;
+      }
+    }
+  }
+
+  std::cout
+      << "Poses                 = " << poses << std::endl
+      << "Affine pairs          = " << pairsAffine << std::endl
+      << "Rebuild pairs         = " << pairsRebuild << std::endl
+      << "Exact pairs           = " << pairsExact << std::endl
+      << "Exact pairs missing   = " << exactMissing << std::endl
+      << "Pairs not in rebuild  = " << rebuildExtra << std::endl
+      << "Collision mismatches  = " << collisionMismatches << std::endl
+      << std::endl;
+
+  if (pairsExact == 0 || exactMissing != 0 || rebuildExtra != 0 || collisionMismatches != 0)
+  {
+    std::cout << "Check the affine AABB tree queries!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 34: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 35 - AABB TREE STATISTICS AND COUNTERS
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Check the query counters
+bool
+countersEqual(AABBtree::counters const &counters, size_t nodes, size_t boxes, size_t items)
+{
+  return counters.nodes == nodes && counters.boxes == boxes && counters.items == items;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 35 - AABB TREE STATISTICS AND COUNTERS" << std::endl
+      << std::endl;
+
+  // Eight disjoint boxes on a line make a balanced tree with the midpoint split
+  aabb::vecptr vecLine;
+  for (integer i = 0; i < 8; ++i)
+    vecLine.push_back(aabb::ptr(new aabb(i - 0.25, -0.25, -0.25, i + 0.25, 0.25, 0.25, i, 0)));
+  AABBtree treeLine;
+  treeLine.build(vecLine);
+  AABBtree::statistics line = treeLine.getStatistics();
+  bool lineValid = line.nodes == 15 && line.leaves == 8 && line.depth == 3 &&
+                   line.mean_depth == 3.0 && line.occupancy == 1.0 && line.overlap == 0.0 &&
+                   line.depth_histogram == std::vector<integer>({0, 0, 0, 8}) &&
+                   line.leaf_histogram == std::vector<integer>({0, 8});
+
+  // The same boxes in leaves of two boxes
+  AABBtree treePairs;
+  treePairs.setLeafSize(2);
+  treePairs.build(vecLine);
+  AABBtree::statistics pairs = treePairs.getStatistics();
+  bool pairsValid = pairs.nodes == 7 && pairs.leaves == 4 && pairs.depth == 2 &&
+                    pairs.mean_depth == 2.0 && pairs.occupancy == 2.0 &&
+                    pairs.depth_histogram == std::vector<integer>({0, 0, 4}) &&
+                    pairs.leaf_histogram == std::vector<integer>({0, 0, 4});
+
+  // Two overlapping boxes, the sibling overlap is a unit cube
+  aabb::vecptr vecOverlap;
+  vecOverlap.push_back(aabb::ptr(new aabb(0.0, 0.0, 0.0, 2.0, 2.0, 2.0, 0, 0)));
+  vecOverlap.push_back(aabb::ptr(new aabb(1.0, 1.0, 1.0, 3.0, 3.0, 3.0, 1, 0)));
+  AABBtree treeOverlap;
+  treeOverlap.build(vecOverlap);
+  AABBtree::statistics overlap = treeOverlap.getStatistics();
+  bool overlapValid = overlap.nodes == 3 && overlap.leaves == 2 && overlap.depth == 1 &&
+                      std::abs(overlap.overlap - 1.0) < EPSILON;
+
+  // A query box on the first box visits the root, the three nodes on the
+  // path to the first leaf and their three siblings, and tests one box
+  aabb query(-0.1, -0.1, -0.1, 0.1, 0.1, 0.1, 0, 0);
+  aabb::vecptr candidates;
+  treeLine.intersection(query, candidates);
+  bool countersValid = countersEqual(treeLine.getCounters(), 0, 0, 0);
+  treeLine.setCounting(true);
+  treeLine.intersection(query, candidates);
+  countersValid = countersValid && countersEqual(treeLine.getCounters(), 7, 1, 1);
+  treeLine.intersection(query, candidates);
+  countersValid = countersValid && countersEqual(treeLine.getCounters(), 14, 2, 2);
+  treeLine.resetCounters();
+  countersValid = countersValid && countersEqual(treeLine.getCounters(), 0, 0, 0);
+  treeLine.intersection(query, candidates);
+  countersValid = countersValid && countersEqual(treeLine.getCounters(), 7, 1, 1);
+  treeLine.setCounting(false);
+  treeLine.intersection(query, candidates);
+  countersValid = countersValid && countersEqual(treeLine.getCounters(), 7, 1, 1);
+
+  std::cout
+      << "Line nodes         = " << line.nodes << std::endl
+      << "Line leaves        = " << line.leaves << std::endl
+      << "Line depth         = " << line.depth << std::endl
+      << "Pairs nodes        = " << pairs.nodes << std::endl
+      << "Pairs leaves       = " << pairs.leaves << std::endl
+      << "Pairs occupancy    = " << pairs.occupancy << std::endl
+      << "Overlap volume     = " << overlap.overlap << std::endl
+      << "Counted nodes      = " << treeLine.getCounters().nodes << std::endl
+      << "Counted boxes      = " << treeLine.getCounters().boxes << std::endl
+      << "Counted items      = " << treeLine.getCounters().items << std::endl
+      << std::endl;
+
+  if (!lineValid || !pairsValid || !overlapValid || !countersValid)
+  {
+    std::cout << "Check the AABB tree statistics!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 35: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
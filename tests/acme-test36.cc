@@ -0,0 +1,149 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 36 - AABB TREE TRAVERSAL EARLY STOP
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Number of calls of the callbacks of a tree-vs-tree query stopped at a given
+// call, for the collision, the affine collision and the intersection visit
+struct stopCalls
+{
+  integer collision;
+  integer affine;
+  integer visit;
+  bool stopped;
+};
+
+stopCalls
+stopAt(AABBtree const &tree0, AABBtree const &tree1, affine const &transform, integer stop, bool swap_tree)
+{
+  stopCalls calls = {0, 0, 0, true};
+  calls.stopped = tree0.collision(
+                      tree1, [&](aabb::ptr const &, aabb::ptr const &) { return calls.collision++ == stop; }, swap_tree) &&
+                  calls.stopped;
+  calls.stopped = tree0.collision(
+                      tree1, transform, [&](aabb::ptr const &, aabb::ptr const &) { return calls.affine++ == stop; }, swap_tree) &&
+                  calls.stopped;
+  calls.stopped = tree0.visitIntersection(
+                      tree1, [&](integer, integer) { return calls.visit++ == stop; }, swap_tree) &&
+                  calls.stopped;
+  return calls;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 36 - AABB TREE TRAVERSAL EARLY STOP" << std::endl
+      << std::endl;
+
+  // Initialize a grid of overlapping boxes and a chain of overlapping boxes
+  // whose centres halve their distance from the origin, which builds a tree
+  // so deep that the traversal of the chain against itself, which descends
+  // both trees, fills the local stack
+  aabb::vecptr vecGrid, vecChain;
+  for (integer i = 0; i < 20; ++i)
+  {
+    for (integer j = 0; j < 20; ++j)
+    {
+      real d = 0.6 + 0.3 * std::sin(1.7 * (i + 2 * j));
+      vecGrid.push_back(aabb::ptr(new aabb(i - d, j - d, -d, i + d, j + d, d, vecGrid.size(), 0)));
+    }
+  }
+  for (integer k = 0; k < 80; ++k)
+  {
+    real x = std::pow(0.5, k);
+    vecChain.push_back(aabb::ptr(new aabb(x - 2.0, -2.0, -2.0, x + 2.0, 2.0, 2.0, k, 0)));
+  }
+  affine identity(affine::Identity());
+
+  integer leafSizes[2] = {1, 4};
+  integer queries = 0, mismatches = 0, depth = 0;
+  for (integer l = 0; l < 2; ++l)
+  {
+    AABBtree treeGrid, treeChain;
+    treeGrid.setLeafSize(leafSizes[l]);
+    treeChain.setLeafSize(leafSizes[l]);
+    treeGrid.build(vecGrid);
+    treeChain.build(vecChain);
+    depth = std::max(depth, treeChain.getStatistics().depth);
+
+    AABBtree const *trees[2][2] = {{&treeGrid, &treeGrid}, {&treeChain, &treeChain}};
+    for (integer t = 0; t < 2; ++t)
+    {
+      AABBtree const &tree0 = *trees[t][0];
+      AABBtree const &tree1 = *trees[t][1];
+      for (integer s = 0; s < 2; ++s)
+      {
+        // Number of calls of an unstopped traversal, the same for all the
+        // queries since the identity transformation keeps the frames
+        stopCalls all = stopAt(tree0, tree1, identity, -1, s == 1);
+        if (all.stopped || all.affine != all.collision || all.visit != all.collision)
+          ++mismatches;
+
+        // A callback that returns true is the last one called
+        integer stops[4] = {0, 1, all.collision / 2, all.collision - 1};
+        for (integer k = 0; k < 4; ++k)
+        {
+          stopCalls calls = stopAt(tree0, tree1, identity, stops[k], s == 1);
+          ++queries;
+          if (!calls.stopped || calls.collision != stops[k] + 1 ||
+              calls.affine != stops[k] + 1 || calls.visit != stops[k] + 1)
+            ++mismatches;
+        }
+      }
+    }
+  }
+
+  std::cout
+      << "Chain tree depth      = " << depth << std::endl
+      << "Stopped queries       = " << queries << std::endl
+      << "Mismatches            = " << mismatches << std::endl
+      << std::endl;
+
+  if (2 * depth <= 64 || mismatches != 0)
+  {
+    std::cout << "Check the AABB tree traversal early stop!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 36: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}
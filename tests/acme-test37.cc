@@ -0,0 +1,235 @@
+/*
+(***********************************************************************)
+(*                                                                     *)
+(* The ACME project                                                    *)
+(*                                                                     *)
+(* Copyright (c) 2020-2021, Davide Stocco and Enrico Bertolazzi.       *)
+(*                                                                     *)
+(* The ACME project and its components are supplied under the terms of *)
+(* the open source BSD 2-Clause License. The contents of the ACME      *)
+(* project and its components may not be copied or disclosed except in *)
+(* accordance with the terms of the BSD 2-Clause License.              *)
+(*                                                                     *)
+(* URL: https://opensource.org/licenses/BSD-2-Clause                   *)
+(*                                                                     *)
+(*    Davide Stocco                                                    *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: davide.stocco@unitn.it                                   *)
+(*                                                                     *)
+(*    Enrico Bertolazzi                                                *)
+(*    Department of Industrial Engineering                             *)
+(*    University of Trento                                             *)
+(*    e-mail: enrico.bertolazzi@unitn.it                               *)
+(*                                                                     *)
+(***********************************************************************)
+*/
+
+// TEST 37 - AABB TREE BUILD DETERMINISM AND DEGENERATE INPUTS
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "acme.hh"
+#include "acme_AABBtree.hh"
+#include "acme_aabb.hh"
+#include "acme_utils.hh"
+
+using namespace acme;
+
+// Check if two builds have the same nodes and the same leaf order of the boxes
+bool
+sameTree(AABBtree const &tree0, AABBtree const &tree1)
+{
+  AABBtree::vecnode const &nodes0 = tree0.nodes();
+  AABBtree::vecnode const &nodes1 = tree1.nodes();
+  if (nodes0.size() != nodes1.size() ||
+      std::memcmp(nodes0.data(), nodes1.data(), nodes0.size() * sizeof(AABBtree::node)) != 0)
+    return false;
+  aabb::vecptr const &boxes0 = tree0.boxes();
+  aabb::vecptr const &boxes1 = tree1.boxes();
+  for (size_t i = 0; i < boxes0.size(); ++i)
+    if (boxes0[i]->id() != boxes1[i]->id())
+      return false;
+  return boxes0.size() == boxes1.size();
+}
+
+// Sorted identifiers of a box list
+std::vector<integer>
+boxIds(aabb::vecptr const &boxes)
+{
+  std::vector<integer> ids;
+  for (size_t i = 0; i < boxes.size(); ++i)
+    ids.push_back(boxes[i]->id());
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Sorted identifier pairs of a pair list, each pair in increasing order if
+// the pairs are unordered
+std::vector<std::pair<integer, integer>>
+pairIds(aabb::vecpairptr const &pairs, bool unordered)
+{
+  std::vector<std::pair<integer, integer>> ids;
+  for (size_t i = 0; i < pairs.size(); ++i)
+  {
+    integer id0 = pairs[i].first->id(), id1 = pairs[i].second->id();
+    if (unordered && id1 < id0)
+      std::swap(id0, id1);
+    ids.push_back(std::make_pair(id0, id1));
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+// Number of mismatches of the box, self and tree-vs-tree queries of a tree
+// against brute force
+integer
+bruteForceMismatches(AABBtree const &tree, aabb::vecptr const &boxes, aabb::vecptr const &queries)
+{
+  integer mismatches = 0;
+  for (size_t q = 0; q < queries.size(); ++q)
+  {
+    aabb::vecptr candidates, expected;
+    tree.intersection(*queries[q], candidates);
+    for (size_t i = 0; i < boxes.size(); ++i)
+      if (boxes[i]->intersects(*queries[q]))
+        expected.push_back(boxes[i]);
+    if (boxIds(candidates) != boxIds(expected))
+      ++mismatches;
+  }
+
+  aabb::vecpairptr pairsSelf, pairsTree, expectedSelf, expectedTree;
+  tree.selfIntersection(pairsSelf);
+  tree.intersection(tree, pairsTree);
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    for (size_t j = 0; j < boxes.size(); ++j)
+    {
+      if (!boxes[i]->intersects(*boxes[j]))
+        continue;
+      expectedTree.push_back(aabb::pairptr(boxes[i], boxes[j]));
+      if (i < j)
+        expectedSelf.push_back(aabb::pairptr(boxes[i], boxes[j]));
+    }
+  }
+  if (pairIds(pairsSelf, true) != pairIds(expectedSelf, true))
+    ++mismatches;
+  if (pairIds(pairsTree, false) != pairIds(expectedTree, false))
+    ++mismatches;
+  return mismatches;
+}
+
+// Main function
+int main()
+{
+  std::cout
+      << "TEST 37 - AABB TREE BUILD DETERMINISM AND DEGENERATE INPUTS" << std::endl
+      << std::endl;
+
+  AABBtree::method methods[3] = {AABBtree::MIDPOINT, AABBtree::SAH, AABBtree::LBVH};
+
+  // Initialize enough scattered boxes to build in parallel
+  aabb::vecptr vecScattered;
+  for (integer k = 0; k < 40000; ++k)
+  {
+    real x = 100.0 * std::sin(1.3 * k);
+    real y = 100.0 * std::cos(1.7 * k);
+    real z = 100.0 * std::sin(2.9 * k + 0.5);
+    real d = 0.1 + 0.2 * (k % 5);
+    vecScattered.push_back(aabb::ptr(new aabb(x - d, y - d, z - d, x + d, y + d, z + d, k, 0)));
+  }
+
+  // The build with one thread and with several threads must give the same
+  // nodes and the same box order
+  integer builds = 0, buildMismatches = 0;
+  integer threads[3] = {2, 3, 8};
+  for (integer m = 0; m < 3; ++m)
+  {
+    AABBtree treeSerial;
+    treeSerial.setMethod(methods[m]);
+    treeSerial.setLeafSize(4);
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+    treeSerial.build(vecScattered);
+    for (integer t = 0; t < 3; ++t)
+    {
+      AABBtree treeParallel;
+      treeParallel.setMethod(methods[m]);
+      treeParallel.setLeafSize(4);
+#ifdef _OPENMP
+      omp_set_num_threads(threads[t]);
+#endif
+      treeParallel.build(vecScattered);
+      ++builds;
+      if (!sameTree(treeSerial, treeParallel))
+        ++buildMismatches;
+    }
+  }
+
+  // Initialize a set of equal boxes, and a chain of boxes with collinear
+  // centres that halve their distance from the origin, on which the midpoint
+  // build splits off one box per level: the tree is deeper than the local
+  // stack of the traversal kernels
+  aabb::vecptr vecEqual, vecChain, vecQueries;
+  for (integer k = 0; k < 500; ++k)
+    vecEqual.push_back(aabb::ptr(new aabb(-1.0, -1.0, -1.0, 1.0, 1.0, 1.0, k, 0)));
+  for (integer k = 0; k < 200; ++k)
+  {
+    real x = std::pow(0.5, k);
+    vecChain.push_back(aabb::ptr(new aabb(0.5 * x, -0.25 * x, -0.25 * x, 1.5 * x, 0.25 * x, 0.25 * x, k, 0)));
+  }
+  for (integer k = 0; k < 20; ++k)
+  {
+    real x = std::pow(0.5, 10 * k);
+    vecQueries.push_back(aabb::ptr(new aabb(0.9 * x, -0.1 * x, -0.1 * x, 1.1 * x, 0.1 * x, 0.1 * x, k, 0)));
+  }
+  vecQueries.push_back(aabb::ptr(new aabb(-1.0, -1.0, -1.0, 0.0, 0.0, 0.0, 20, 0)));
+  vecQueries.push_back(aabb::ptr(new aabb(2.0, 2.0, 2.0, 3.0, 3.0, 3.0, 21, 0)));
+
+  integer depthChain = 0, degenerateMismatches = 0;
+  for (integer m = 0; m < 3; ++m)
+  {
+    for (integer l = 1; l <= 4; l *= 4)
+    {
+      AABBtree treeEqual, treeChain;
+      treeEqual.setMethod(methods[m]);
+      treeChain.setMethod(methods[m]);
+      treeEqual.setLeafSize(l);
+      treeChain.setLeafSize(l);
+      treeEqual.build(vecEqual);
+      treeChain.build(vecChain);
+      depthChain = std::max(depthChain, treeChain.getStatistics().depth);
+      degenerateMismatches += bruteForceMismatches(treeEqual, vecEqual, vecQueries);
+      degenerateMismatches += bruteForceMismatches(treeChain, vecChain, vecQueries);
+    }
+  }
+
+  std::cout
+      << "Parallel builds       = " << builds << std::endl
+      << "Build mismatches      = " << buildMismatches << std::endl
+      << "Chain tree depth      = " << depthChain << std::endl
+      << "Degenerate mismatches = " << degenerateMismatches << std::endl
+      << std::endl;
+
+  if (buildMismatches != 0 || depthChain <= 64 || degenerateMismatches != 0)
+  {
+    std::cout << "Check the AABB tree build determinism and degenerate inputs!" << std::endl;
+    return 1;
+  }
+
+  std::cout
+      << "TEST 37: Completed" << std::endl;
+
+  // Exit the program
+  return 0;
+}